@@ -209,6 +209,22 @@ namespace fart::exceptions {
 
 		};
 
+		class JSONValueTooLongException : public Exception {
+
+		public:
+
+			virtual ~JSONValueTooLongException() = default;
+
+			virtual const char* description() const override {
+				return "JSON string or number is too long.";
+			}
+
+			virtual JSONValueTooLongException* clone() const override {
+				return new JSONValueTooLongException();
+			}
+
+		};
+
 	}
 
 	namespace memory {
@@ -290,6 +306,22 @@ namespace fart::exceptions {
 
 		};
 
+		class FormatException : public Exception {
+
+		public:
+
+			virtual ~FormatException() = default;
+
+			virtual const char* description() const override {
+				return "Format does not match its arguments.";
+			}
+
+			virtual FormatException* clone() const override {
+				return new FormatException();
+			}
+
+		};
+
 		class DecoderException : public Exception {
 
 		private:
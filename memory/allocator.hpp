@@ -10,9 +10,12 @@
 #define allocator_hpp
 
 #include <math.h>
+#include <atomic>
 
 #include "../exceptions/exception.hpp"
 #include "../tools/math.hpp"
+#include "./pool.hpp"
+#include "./arena.hpp"
 
 #ifndef FART_BLOCK_SIZE
 #define FART_BLOCK_SIZE 32
@@ -35,6 +38,28 @@ namespace fart::memory {
 			deallocate(ptr);
 		}
 
+#ifdef FART_ALLOCATOR_STATISTICS
+
+		struct Statistics {
+			size_t size; // Largest size in the class - zero for allocations too large for the pool.
+			uint64_t allocations;
+			uint64_t bytes;
+		};
+
+		inline static size_t sizeClassCount() {
+			return Pool::sizeClassCount + 1;
+		}
+
+		static Statistics statistics(size_t sizeClass) {
+			return {
+				sizeClass < Pool::sizeClassCount ? Pool::blockSize(sizeClass) : 0,
+				_counters()[sizeClass * 2].load(std::memory_order_relaxed),
+				_counters()[sizeClass * 2 + 1].load(std::memory_order_relaxed)
+			};
+		}
+
+#endif
+
 	protected:
 
 		inline static uint64_t calculateBufferLength(const uint64_t& minimumLength) {
@@ -42,16 +67,118 @@ namespace fart::memory {
 			return (uint64_t)pow(2, ceil(log2((math::max<double>(minimumLength, FART_BLOCK_SIZE) / FART_BLOCK_SIZE)))) * FART_BLOCK_SIZE;;
 		}
 
-		static void* allocate(size_t size) noexcept(false) {
-			void *mem = calloc(size, sizeof(uint8_t));
-			if (!mem) throw AllocationException(size);
-			return mem;
+		inline static void* allocate(size_t size) noexcept(false) {
+			return _allocate(size, true);
+		}
+
+		static void deallocate(void* ptr) throw() {
+
+			if (ptr == nullptr) return;
+
+			Header* header = (Header*)ptr - 1;
+
+			if (header->region != nullptr) header->region->release();
+#ifdef FART_POOLED_ALLOCATOR
+			else if (header->sizeClass < Pool::sizeClassCount) Pool::deallocate(header, header->sizeClass);
+#endif
+			else free(header);
+
 		}
 
-		inline static void deallocate(void* ptr) throw() {
-			free(ptr);
+		// Buffers are not zeroed. They stay with the system allocator when they can be
+		// grown in place, otherwise they move to where allocate() would put them now.
+		static void* reallocate(void* ptr, size_t oldSize, size_t size) noexcept(false) {
+
+			if (ptr == nullptr) return _allocate(size, false);
+
+			Header* header = (Header*)ptr - 1;
+
+			if (header->region == nullptr && header->sizeClass == _system && Arena::current() == nullptr) {
+				_count(size);
+				header = (Header*)realloc(header, sizeof(Header) + size);
+				if (!header) throw AllocationException(size);
+				return header + 1;
+			}
+
+#ifdef FART_POOLED_ALLOCATOR
+			if (header->region == nullptr && header->sizeClass < _system && Arena::current() == nullptr && Pool::sizeClass(sizeof(Header) + size) == header->sizeClass) {
+				return ptr;
+			}
+#endif
+
+			void* result = _allocate(size, false);
+			memcpy(result, ptr, math::min(oldSize, size));
+			deallocate(ptr);
+
+			return result;
+
 		}
 
+	private:
+
+		// Precedes every allocation, so blocks can be returned to where they came from.
+		struct alignas(16) Header {
+			size_t sizeClass;
+			Arena::Region* region;
+		};
+
+		static constexpr size_t _system = Pool::sizeClassCount;
+
+		static void* _allocate(size_t size, bool zero) noexcept(false) {
+
+			_count(size);
+
+			Header* header;
+
+			if (Arena* arena = Arena::current()) {
+				Arena::Region* region;
+				header = (Header*)arena->allocate(sizeof(Header) + size, &region);
+				if (zero) memset(header + 1, 0, size);
+				header->sizeClass = _system;
+				header->region = region;
+				return header + 1;
+			}
+
+#ifdef FART_POOLED_ALLOCATOR
+			if (Pool::fits(sizeof(Header) + size)) {
+				size_t sizeClass = Pool::sizeClass(sizeof(Header) + size);
+				header = (Header*)Pool::allocate(sizeClass);
+				if (zero) memset(header + 1, 0, size);
+				header->sizeClass = sizeClass;
+				header->region = nullptr;
+				return header + 1;
+			}
+#endif
+
+			header = (Header*)(zero ? calloc(sizeof(Header) + size, sizeof(uint8_t)) : malloc(sizeof(Header) + size));
+			if (!header) throw AllocationException(size);
+
+			header->sizeClass = _system;
+			header->region = nullptr;
+
+			return header + 1;
+
+		}
+
+#ifdef FART_ALLOCATOR_STATISTICS
+
+		static std::atomic<uint64_t>* _counters() {
+			static std::atomic<uint64_t> counters[(Pool::sizeClassCount + 1) * 2];
+			return counters;
+		}
+
+		inline static void _count(size_t size) {
+			size_t sizeClass = Pool::fits(size) ? Pool::sizeClass(size) : Pool::sizeClassCount;
+			_counters()[sizeClass * 2].fetch_add(1, std::memory_order_relaxed);
+			_counters()[sizeClass * 2 + 1].fetch_add(size, std::memory_order_relaxed);
+		}
+
+#else
+
+		inline static void _count(size_t) {}
+
+#endif
+
 	};
 
 	class NoAllocator {
@@ -0,0 +1,188 @@
+//
+// arena.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef arena_hpp
+#define arena_hpp
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../exceptions/exception.hpp"
+#include "../tools/math.hpp"
+#include "./retain-count.hpp"
+
+#ifndef FART_ARENA_CHUNK_SIZE
+#define FART_ARENA_CHUNK_SIZE 65536
+#endif
+
+using namespace fart::tools;
+using namespace fart::exceptions::memory;
+
+namespace fart::memory {
+
+	// While an Arena::Scope is alive, everything allocated through Allocator on that thread
+	// (objects and Data buffers) is carved out of the arena. Freeing such a block does not
+	// free memory - it is reclaimed in bulk by reset(). Objects that outlive a reset keep
+	// their region alive until the last of them is released.
+	//
+	// An arena must only be used by one thread at a time. Objects allocated in it may be
+	// released from any thread.
+	class Arena {
+
+	public:
+
+		class Region {
+
+			friend class Arena;
+
+		public:
+
+			// Releases a block allocated in this region.
+			inline void release() {
+				if (_retainCount.release()) delete this;
+			}
+
+		private:
+
+			struct alignas(16) Chunk {
+				Chunk* next;
+				size_t size;
+				size_t used;
+			};
+
+			Region() : _retainCount(1), _first(nullptr), _current(nullptr) {}
+
+			~Region() {
+				while (_first != nullptr) {
+					Chunk* next = _first->next;
+					free(_first);
+					_first = next;
+				}
+			}
+
+			void* allocate(size_t size, size_t chunkSize) noexcept(false) {
+
+				// Keep all blocks 16 byte aligned.
+				size = (size + 15) & ~(size_t)15;
+
+				// Move on to chunks kept from before a rewind, or add a new one after the current.
+				while (_current == nullptr || _current->size - _current->used < size) {
+					if (_current != nullptr && _current->next != nullptr && _current->next->size >= size) {
+						_current = _current->next;
+						_current->used = 0;
+						continue;
+					}
+					size_t length = sizeof(Chunk) + math::max(chunkSize, size);
+					Chunk* chunk = (Chunk*)malloc(length);
+					if (!chunk) throw AllocationException(length);
+					chunk->size = length - sizeof(Chunk);
+					chunk->used = 0;
+					if (_current == nullptr) {
+						chunk->next = _first;
+						_first = chunk;
+					} else {
+						chunk->next = _current->next;
+						_current->next = chunk;
+					}
+					_current = chunk;
+				}
+
+				void* result = (uint8_t*)(_current + 1) + _current->used;
+				_current->used += size;
+
+				_retainCount.retain();
+
+				return result;
+
+			}
+
+			// Chunks are kept, and reused in order.
+			void rewind() {
+				_current = _first;
+				if (_current != nullptr) _current->used = 0;
+			}
+
+			// One retain for the arena itself, and one for each live block.
+			RetainCount _retainCount;
+			Chunk* _first;
+			Chunk* _current;
+
+		};
+
+		class Scope {
+
+		public:
+
+			Scope(Arena& arena) : _previous(Arena::_current()) {
+				Arena::_current() = &arena;
+			}
+
+			// Allocations go to the heap while a scope without an arena is alive - even inside the
+			// scope of one.
+			Scope(nullptr_t) : _previous(Arena::_current()) {
+				Arena::_current() = nullptr;
+			}
+
+			~Scope() {
+				Arena::_current() = _previous;
+			}
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+
+			Arena* _previous;
+
+		};
+
+		Arena(size_t chunkSize = FART_ARENA_CHUNK_SIZE) : _chunkSize(chunkSize), _region(new Region()) {}
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		~Arena() {
+			if (Arena::_current() == this) Arena::_current() = nullptr;
+			_region->release();
+		}
+
+		// Reclaims all memory of the arena. If objects allocated in it are still alive, their
+		// memory is left to them, and the arena continues in fresh chunks.
+		void reset() {
+			if (_region->_retainCount.isUnique()) {
+				_region->rewind();
+			} else {
+				_region->release();
+				_region = new Region();
+			}
+		}
+
+		inline void* allocate(size_t size, Region** region) noexcept(false) {
+			*region = _region;
+			return _region->allocate(size, _chunkSize);
+		}
+
+		inline static Arena* current() {
+			return _current();
+		}
+
+	private:
+
+		size_t _chunkSize;
+		Region* _region;
+
+		static Arena*& _current() {
+			static thread_local Arena* current = nullptr;
+			return current;
+		}
+
+	};
+
+}
+
+#endif /* arena_hpp */
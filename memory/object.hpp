@@ -16,6 +16,11 @@
 #include "../threading/mutex.hpp"
 #include "./weak.hpp"
 #include "./allocator.hpp"
+#include "./retain-count.hpp"
+
+#ifndef FART_WEAK_REFERENCE_MUTEXES
+#define FART_WEAK_REFERENCE_MUTEXES 64
+#endif
 
 using namespace fart::threading;
 using namespace fart::exceptions::memory;
@@ -23,6 +28,8 @@ using namespace fart::exceptions::memory;
 namespace fart::types {
 	template<typename T>
 	class Array;
+	template<typename Key, class Value, class Policy>
+	class Dictionary;
 }
 
 namespace fart::memory {
@@ -44,48 +51,62 @@ namespace fart::memory {
 		template<typename T>
 		friend class ::fart::types::Array;
 
+		template<typename Key, class Value, class Policy>
+		friend class ::fart::types::Dictionary;
+
 	private:
 
-		mutable size_t _retainCount;
-		mutable void** _weakReferences;
-		mutable size_t _weakReferencesSize;
-		mutable size_t _weakReferencesCount;
-
-		void addWeakReference(void* weakReference) const {
-			if (_weakReferencesSize < _weakReferencesCount + 1) {
-				_weakReferencesSize = calculateBufferLength(_weakReferencesCount + 1);
-				_weakReferences = (void**)realloc(_weakReferences, _weakReferencesSize);
-				_weakReferences[_weakReferencesCount++] = weakReference;
-			}
+		mutable RetainCount _retainCount;
+		mutable std::atomic<WeakReference*> _weakReferences;
+
+		// Weak references are guarded by a mutex picked by the object's address, so objects
+		// do not need to carry one each.
+		static Mutex& _weakReferencesMutex(const Object* object) {
+			// Intentionally never destroyed, as objects are released during static destruction.
+			static Mutex* mutexes = new Mutex[FART_WEAK_REFERENCE_MUTEXES];
+			return mutexes[((uintptr_t)object >> 4) % FART_WEAK_REFERENCE_MUTEXES];
+		}
+
+		// Must be called with the mutex held.
+		void addWeakReference(WeakReference* weakReference) const {
+			weakReference->_previous = nullptr;
+			weakReference->_next = _weakReferences.load();
+			if (weakReference->_next != nullptr) weakReference->_next->_previous = weakReference;
+			_weakReferences = weakReference;
+		}
+
+		// Must be called with the mutex held.
+		void removeWeakReference(WeakReference* weakReference) const {
+			if (weakReference->_previous != nullptr) weakReference->_previous->_next = weakReference->_next;
+			else _weakReferences = weakReference->_next;
+			if (weakReference->_next != nullptr) weakReference->_next->_previous = weakReference->_previous;
+			weakReference->_previous = nullptr;
+			weakReference->_next = nullptr;
 		}
 
-		void removeWeakReference(void* weakReference) const {
-			for (size_t idx = 0 ; idx < _weakReferencesCount ; idx++) {
-				if (_weakReferences[idx] == weakReference) {
-					for (size_t midx = idx ; midx <= _weakReferencesCount - 1 ; midx++) {
-						_weakReferences[midx] = _weakReferences[midx + 1];
-					}
-					_weakReferencesCount--;
+		// Clears the weak references to the object.
+		void clearWeakReferences() const {
+			if (_weakReferences == nullptr) return;
+			_weakReferencesMutex(this).locked([&]() {
+				while (_weakReferences != nullptr) {
+					WeakReference* weakReference = _weakReferences.load();
+					removeWeakReference(weakReference);
+					weakReference->_object = nullptr;
 				}
-			}
+			});
 		}
 
 	public:
 
-		Object() : _retainCount(0), _weakReferences(nullptr), _weakReferencesSize(0), _weakReferencesCount(0) {}
+		Object() : _retainCount(0), _weakReferences(nullptr) {}
 
 		Object(const Object&) : Object() { }
 
 		Object(Object&&) : Object() { }
 
 		virtual ~Object() {
-			assert(_retainCount == 0);
-			for (size_t idx = 0 ; idx < _weakReferencesCount ; idx++) {
-				((Weak<Object>*)_weakReferences[idx])->_object = nullptr;
-			}
-			if (_weakReferences != nullptr) {
-				free(_weakReferences);
-			}
+			assert(_retainCount.count() == 0);
+			this->clearWeakReferences();
 		}
 
 		Object& operator=(const Object&) {
@@ -103,15 +124,19 @@ namespace fart::memory {
 #endif
 
 		void retain() const {
-			this->_retainCount++;
+			this->_retainCount.retain();
 		}
 
 		void release() const {
-			if (--this->_retainCount == 0) delete this;
+			if (!this->_retainCount.release()) return;
+			// Weak references are cleared before the destructors run, so they are not made strong
+			// while the object is destroyed.
+			this->clearWeakReferences();
+			delete this;
 		}
 
 		size_t retainCount() const {
-			return this->_retainCount;
+			return this->_retainCount.count();
 		}
 
 	};
@@ -0,0 +1,218 @@
+//
+// pool.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef pool_hpp
+#define pool_hpp
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../threading/mutex.hpp"
+#include "../exceptions/exception.hpp"
+#include "../tools/math.hpp"
+
+#ifndef FART_POOL_MAXIMUM_SIZE
+#define FART_POOL_MAXIMUM_SIZE 512
+#endif
+
+#ifndef FART_POOL_SLAB_SIZE
+#define FART_POOL_SLAB_SIZE 65536
+#endif
+
+#ifndef FART_POOL_CACHE_LIMIT
+#define FART_POOL_CACHE_LIMIT 4096
+#endif
+
+using namespace fart::threading;
+using namespace fart::tools;
+using namespace fart::exceptions::memory;
+
+namespace fart::memory {
+
+	// Size-class pools for small allocations. Each thread keeps a free list per size class,
+	// and lists are handed to a shared depot when they grow large or the thread exits. Slabs
+	// are never returned to the system.
+	class Pool {
+
+	public:
+
+		static constexpr size_t granularity = 16;
+		static constexpr size_t sizeClassCount = FART_POOL_MAXIMUM_SIZE / granularity;
+
+		static_assert(FART_POOL_MAXIMUM_SIZE % granularity == 0);
+
+		inline static bool fits(size_t size) {
+			return size <= FART_POOL_MAXIMUM_SIZE;
+		}
+
+		inline static size_t sizeClass(size_t size) {
+			return size == 0 ? 0 : (size - 1) / granularity;
+		}
+
+		inline static size_t blockSize(size_t sizeClass) {
+			return (sizeClass + 1) * granularity;
+		}
+
+		static void* allocate(size_t sizeClass) noexcept(false) {
+
+			Cache& cache = _cache();
+
+			if (cache.heads[sizeClass] == nullptr) _refill(cache, sizeClass);
+
+			Block* block = cache.heads[sizeClass];
+			cache.heads[sizeClass] = block->next;
+			cache.counts[sizeClass]--;
+
+			return block;
+
+		}
+
+		static void deallocate(void* ptr, size_t sizeClass) {
+
+			Cache& cache = _cache();
+
+			Block* block = (Block*)ptr;
+
+			if (cache.exited) {
+				// Thread is tearing down - give the block straight to the depot.
+				_depot().give(block, block, 1, sizeClass);
+				return;
+			}
+
+			block->next = cache.heads[sizeClass];
+			cache.heads[sizeClass] = block;
+
+			if (++cache.counts[sizeClass] > FART_POOL_CACHE_LIMIT) _flush(cache, sizeClass);
+
+		}
+
+	private:
+
+		struct Block {
+			Block* next;
+		};
+
+		// Plain data, so it stays usable while thread local destructors run.
+		struct Cache {
+			Block* heads[sizeClassCount];
+			size_t counts[sizeClassCount];
+			bool exited;
+		};
+
+		class Flusher {
+
+		public:
+
+			Flusher(Cache& cache) : _cache(cache) {}
+
+			~Flusher() {
+				for (size_t sizeClass = 0 ; sizeClass < sizeClassCount ; sizeClass++) {
+					_flush(_cache, sizeClass);
+				}
+				_cache.exited = true;
+			}
+
+		private:
+
+			Cache& _cache;
+
+		};
+
+		class Depot {
+
+		public:
+
+			Depot() {
+				for (size_t sizeClass = 0 ; sizeClass < sizeClassCount ; sizeClass++) {
+					_heads[sizeClass] = nullptr;
+					_counts[sizeClass] = 0;
+				}
+			}
+
+			void give(Block* head, Block* tail, size_t count, size_t sizeClass) {
+				_mutex.locked([&]() {
+					tail->next = _heads[sizeClass];
+					_heads[sizeClass] = head;
+					_counts[sizeClass] += count;
+				});
+			}
+
+			Block* take(size_t sizeClass, size_t* count) {
+				return _mutex.lockedValue([&]() {
+					Block* head = _heads[sizeClass];
+					*count = _counts[sizeClass];
+					_heads[sizeClass] = nullptr;
+					_counts[sizeClass] = 0;
+					return head;
+				});
+			}
+
+		private:
+
+			Mutex _mutex;
+			Block* _heads[sizeClassCount];
+			size_t _counts[sizeClassCount];
+
+		};
+
+		static Cache& _cache() {
+			static thread_local Cache cache = {};
+			static thread_local Flusher flusher(cache);
+			(void)flusher;
+			return cache;
+		}
+
+		static Depot& _depot() {
+			// Intentionally never destroyed, as blocks are released during static destruction.
+			static Depot* depot = new Depot();
+			return *depot;
+		}
+
+		static void _flush(Cache& cache, size_t sizeClass) {
+			Block* head = cache.heads[sizeClass];
+			if (head == nullptr) return;
+			Block* tail = head;
+			while (tail->next != nullptr) tail = tail->next;
+			_depot().give(head, tail, cache.counts[sizeClass], sizeClass);
+			cache.heads[sizeClass] = nullptr;
+			cache.counts[sizeClass] = 0;
+		}
+
+		static void _refill(Cache& cache, size_t sizeClass) noexcept(false) {
+
+			size_t count = 0;
+			Block* head = _depot().take(sizeClass, &count);
+
+			if (head == nullptr) {
+
+				size_t size = blockSize(sizeClass);
+				size_t slabSize = math::max<size_t>(FART_POOL_SLAB_SIZE, size * 32);
+
+				uint8_t* slab = (uint8_t*)malloc(slabSize);
+				if (!slab) throw AllocationException(slabSize);
+
+				count = slabSize / size;
+
+				for (size_t idx = count ; idx > 0 ; idx--) {
+					Block* block = (Block*)(slab + (idx - 1) * size);
+					block->next = head;
+					head = block;
+				}
+
+			}
+
+			cache.heads[sizeClass] = head;
+			cache.counts[sizeClass] = count;
+
+		}
+
+	};
+
+}
+
+#endif /* pool_hpp */
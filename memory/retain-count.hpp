@@ -0,0 +1,94 @@
+//
+// retain-count.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef retain_count_hpp
+#define retain_count_hpp
+
+#include <stddef.h>
+#include <atomic>
+
+namespace fart::memory {
+
+	// Retain counts are atomic by default, as objects are handed between threads (sockets,
+	// servers). Define FART_NO_ATOMIC_RETAIN_COUNT for single threaded builds.
+	class RetainCount {
+
+	public:
+
+		RetainCount(size_t count = 0) : _count(count) {}
+
+		RetainCount(const RetainCount&) = delete;
+		RetainCount& operator=(const RetainCount&) = delete;
+
+		inline void retain() {
+#ifdef FART_NO_ATOMIC_RETAIN_COUNT
+			_count++;
+#else
+			_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+		}
+
+		// Retains unless the count has reached zero, and returns whether it did - so an object being
+		// destroyed is not retained again.
+		inline bool tryRetain() {
+#ifdef FART_NO_ATOMIC_RETAIN_COUNT
+			if (_count == 0) return false;
+			_count++;
+			return true;
+#else
+			size_t count = _count.load(std::memory_order_relaxed);
+			while (count != 0) {
+				if (_count.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) return true;
+			}
+			return false;
+#endif
+		}
+
+		// Returns true when the last retain was released.
+		inline bool release() {
+#ifdef FART_NO_ATOMIC_RETAIN_COUNT
+			return --_count == 0;
+#else
+			if (_count.fetch_sub(1, std::memory_order_release) != 1) return false;
+			// Make all writes from other releasing threads visible before destruction.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return true;
+#endif
+		}
+
+		// Whether the holder is the only one. Acquires the releases of former holders, so their
+		// writes are visible before the memory is reused or mutated.
+		inline bool isUnique() const {
+#ifdef FART_NO_ATOMIC_RETAIN_COUNT
+			return _count == 1;
+#else
+			return _count.load(std::memory_order_acquire) == 1;
+#endif
+		}
+
+		inline size_t count() const {
+#ifdef FART_NO_ATOMIC_RETAIN_COUNT
+			return _count;
+#else
+			return _count.load(std::memory_order_relaxed);
+#endif
+		}
+
+	private:
+
+#ifdef FART_NO_ATOMIC_RETAIN_COUNT
+		size_t _count;
+#else
+		std::atomic<size_t> _count;
+#endif
+
+	};
+
+}
+
+#endif /* retain_count_hpp */
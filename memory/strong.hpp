@@ -52,6 +52,8 @@ namespace fart::memory {
 					_object = object;
 				}
 				_object->retain();
+			} else {
+				_object = nullptr;
 			}
 
 			if (oldObject != nullptr) {
@@ -91,7 +93,11 @@ namespace fart::memory {
 			other._object = nullptr;
 		}
 
-		Strong(const Weak<T>& other) : _object(other) {}
+		// Null if the object is gone, or is being destroyed on another thread.
+		Strong(const Weak<T>& other) : _object(other._retain()) {}
+
+		// Otherwise taken by the constructor below, which would copy the object.
+		Strong(Weak<T>& other) : Strong((const Weak<T>&)other) {}
 
 		template<typename... Args>
 		explicit Strong(Args&&... args) : _object(nullptr) {
@@ -120,9 +126,8 @@ namespace fart::memory {
 			return *this;
 		}
 
-		Strong<T>& operator =(Weak<T> object) {
-			_setObject(object);
-			return *this;
+		Strong<T>& operator =(const Weak<T>& object) {
+			return *this = Strong<T>(object);
 		}
 
 		Strong<T>& operator =(const Strong<T>& object) {
@@ -21,12 +21,30 @@ namespace fart::memory {
 	template<typename T>
 	class Strong;
 
+	// Node in an object's list of weak references.
+	class WeakReference {
+
+		friend class Object;
+
+		template<typename T>
+		friend class Weak;
+
+	private:
+
+		WeakReference() : _object(nullptr), _previous(nullptr), _next(nullptr) {}
+
+		std::atomic<Object*> _object;
+		WeakReference* _previous;
+		WeakReference* _next;
+
+	};
+
 	template<typename T = Object>
-	class Weak
+	class Weak : private WeakReference
 #ifdef FART_ALLOW_MANUAL_HEAP
-	: public Allocator
+	, public Allocator
 #else
-	: public NoAllocator
+	, public NoAllocator
 #endif
 	{
 
@@ -34,35 +52,76 @@ namespace fart::memory {
 
 		friend class Object;
 
+		template<typename O>
+		friend class Strong;
+
+		template<typename O>
+		friend class Weak;
+
 	private:
-		std::atomic<T*> _object;
 
-		void _setObject(T* object) {
-			if (_object != nullptr) {
-				_object.load()->removeWeakReference(this);
+		inline T* _get() const {
+			return static_cast<T*>(_object.load());
+		}
+
+		// With source - the reference object is read from - the object is only set if source still
+		// refers to it under the mutex, as it may have been destroyed since it was read.
+		void _setObject(T* object, const std::atomic<Object*>* source = nullptr) {
+
+			T* oldObject = _get();
+
+			if (object == oldObject) return;
+
+			if (oldObject != nullptr) {
+				T::_weakReferencesMutex(oldObject).locked([&]() {
+					// The object might have been destroyed while we were waiting.
+					if (_get() == oldObject) {
+						oldObject->removeWeakReference(this);
+						_object = nullptr;
+					}
+				});
 			}
-			_object = object;
-			if (_object) {
-				_object.load()->addWeakReference(this);
+
+			if (object != nullptr) {
+				T::_weakReferencesMutex(object).locked([&]() {
+					if (source != nullptr && source->load() != object) return;
+					object->addWeakReference(this);
+					_object = object;
+				});
 			}
+
+		}
+
+		// Retains the object and returns it - or null if it is gone or being destroyed.
+		T* _retain() const {
+			T* object = _get();
+			if (object == nullptr) return nullptr;
+			bool retained = false;
+			T::_weakReferencesMutex(object).locked([&]() {
+				retained = _get() == object && object->_retainCount.tryRetain();
+			});
+			return retained ? object : nullptr;
 		}
 
 	public:
 		Weak() : Weak(nullptr) {}
 		Weak(T& object) : Weak(&object) {}
 
-		Weak(T* object) : _object(nullptr) {
+		Weak(T* object) {
 			_setObject(object);
 		}
 
-		Weak(std::nullptr_t) : _object(nullptr) {
-			_setObject(nullptr);
-		}
+		Weak(std::nullptr_t) {}
 
 		Weak(const Strong<T>& other) : Weak(*other) {}
 
-		Weak(Weak<T>&& other) : _object(other._object) {
-			other._object = nullptr;
+		Weak(const Weak<T>& other) {
+			_setObject(other._get(), &other._object);
+		}
+
+		Weak(Weak<T>&& other) {
+			_setObject(other._get(), &other._object);
+			other._setObject(nullptr);
 		}
 
 		~Weak() {
@@ -74,11 +133,11 @@ namespace fart::memory {
 		}
 
 		operator T&() const {
-			return *_object;
+			return *_get();
 		}
 
 		operator T*() const {
-			return _object;
+			return _get();
 		}
 
 		Weak<T>& operator =(T& object) {
@@ -86,8 +145,13 @@ namespace fart::memory {
 			return *this;
 		}
 
-		Weak<T>& operator =(T&& other) {
-			_setObject(other._object);
+		Weak<T>& operator =(const Weak<T>& other) {
+			_setObject(other._get(), &other._object);
+			return *this;
+		}
+
+		Weak<T>& operator =(Weak<T>&& other) {
+			_setObject(other._get(), &other._object);
 			other._setObject(nullptr);
 			return *this;
 		}
@@ -103,7 +167,7 @@ namespace fart::memory {
 		}
 
 		T* operator ->() const {
-			return _object;
+			return _get();
 		}
 
 		bool operator==(std::nullptr_t) const {
@@ -116,7 +180,9 @@ namespace fart::memory {
 
 		template<typename O>
 		Weak<O> as() const {
-			return Weak<O>((O*)_object.load());
+			Weak<O> result;
+			result._setObject((O*)_get(), &_object);
+			return result;
 		}
 
 	};
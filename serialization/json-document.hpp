@@ -0,0 +1,350 @@
+//
+// json-document.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef json_document_hpp
+#define json_document_hpp
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../memory/object.hpp"
+#include "../memory/allocator.hpp"
+#include "../exceptions/exception.hpp"
+#include "../types/type.hpp"
+#include "../types/data.hpp"
+#include "../types/string.hpp"
+#include "../tools/math.hpp"
+#include "./json-index.hpp"
+#include "./json.hpp"
+
+using namespace fart::memory;
+using namespace fart::types;
+using namespace fart::exceptions::serialization;
+using namespace fart::exceptions::types;
+using namespace fart::tools;
+
+namespace fart::serialization {
+
+	// A JSON document that is only parsed where it is read. It keeps the document and the offsets
+	// of its structurals (see JSONIndex), and its values are positions in those - so finding a key
+	// or an item steps over the values before it by their structurals, without looking inside
+	// them. Values are only made (as JSON::parse makes them) when asked for.
+	//
+	// Only what is read is validated, so malformed values elsewhere in the document are not
+	// noticed. Errors are thrown as JSON::parse throws them, but not always for the first
+	// malformed part of the document, as it is not read in order.
+	class JSONDocument : public Object {
+
+	public:
+
+		// A value of the document, which must not outlive it.
+		class Value {
+
+			friend class JSONDocument;
+
+		public:
+
+			Type::Kind kind() const noexcept(false) {
+				return _document->_kind(_position);
+			}
+
+			inline bool is(Type::Kind kind) const noexcept(false) {
+				return this->kind() == kind;
+			}
+
+			// The items of an array, or the entries of an object.
+			size_t count() const noexcept(false) {
+				size_t result = 0;
+				this->_each([&](size_t, size_t) {
+					result++;
+					return true;
+				});
+				return result;
+			}
+
+			// Of duplicate keys, the last is found, as JSON::parse keeps it - so all of the object is
+			// stepped over.
+			inline bool hasKey(const String& key) const noexcept(false) {
+				return this->_find(key) != NotFound;
+			}
+
+			Value operator[](const String& key) const noexcept(false) {
+				size_t position = this->_find(key);
+				if (position == NotFound) throw KeyNotFoundException();
+				return Value(_document, position, _level + 1);
+			}
+
+			Value operator[](size_t index) const noexcept(false) {
+				if (_document->_byte(_position) != '[') throw TypeConversionException();
+				size_t position = NotFound;
+				size_t idx = 0;
+				this->_each([&](size_t, size_t valuePosition) {
+					if (idx++ < index) return true;
+					position = valuePosition;
+					return false;
+				});
+				if (position == NotFound) throw OutOfBoundException(index);
+				return Value(_document, position, _level + 1);
+			}
+
+			void forEach(function<void(const Value& value)> todo) const noexcept(false) {
+				if (_document->_byte(_position) != '[') throw TypeConversionException();
+				this->_each([&](size_t, size_t valuePosition) {
+					todo(Value(_document, valuePosition, _level + 1));
+					return true;
+				});
+			}
+
+			// Keys are values too, so they are only made if needed. As in JSON::parse, they are not
+			// nested deeper than their object.
+			void forEach(function<void(const Value& key, const Value& value)> todo) const noexcept(false) {
+				if (_document->_byte(_position) != '{') throw TypeConversionException();
+				this->_each([&](size_t keyPosition, size_t valuePosition) {
+					todo(Value(_document, keyPosition, _level), Value(_document, valuePosition, _level + 1));
+					return true;
+				});
+			}
+
+			// Makes the value and everything in it.
+			inline Strong<Type> value() const noexcept(false) {
+				return _document->_make(_position, _level);
+			}
+
+		private:
+
+			Value(const JSONDocument* document, size_t position, size_t level) : _document(document), _position(position), _level(level) {}
+
+			const JSONDocument* _document;
+			size_t _position;
+			// How deeply the value is nested, so it is made as deep as JSON::parse would allow.
+			size_t _level;
+
+			// Calls todo with the positions of the key (NotFound in arrays) and value of each
+			// entry, until it returns false.
+			template<typename Func>
+			void _each(Func todo) const noexcept(false) {
+
+				const JSONDocument& document = *_document;
+
+				uint8_t open = document._byte(_position);
+
+				if (open != '{' && open != '[') throw TypeConversionException();
+
+				uint8_t close = open == '{' ? '}' : ']';
+
+				size_t position = _position + 1;
+
+				if (document._byte(position) == close) return;
+
+				while (true) {
+
+					size_t keyPosition = NotFound;
+
+					if (open == '{') {
+						keyPosition = position;
+						if (document._byte(keyPosition) != '"') throw document._malformed(keyPosition);
+						if (document._byte(keyPosition + 2) != ':') throw document._malformed(keyPosition + 2);
+						position = keyPosition + 3;
+					}
+
+					if (_level + 1 > JSON::_maximumLevel) throw document._malformed(position);
+
+					document._kind(position);
+
+					if (!todo(keyPosition, position)) return;
+
+					position = document._skip(position);
+
+					uint8_t separator = document._byte(position);
+
+					if (separator == close) return;
+					if (separator != ',') throw document._malformed(position);
+
+					position++;
+
+				}
+
+			}
+
+			size_t _find(const String& key) const noexcept(false) {
+				if (_document->_byte(_position) != '{') throw TypeConversionException();
+				Strong<Data<uint8_t>> encoded = key.UTF8Data();
+				size_t result = NotFound;
+				this->_each([&](size_t keyPosition, size_t valuePosition) {
+					if (_document->_isKey(keyPosition, *encoded, key)) result = valuePosition;
+					return true;
+				});
+				return result;
+			}
+
+		};
+
+		JSONDocument(const Data<uint8_t>& data) noexcept(false) : _data(data), _bytes(nullptr), _length(0), _offsets(nullptr), _count(0) {
+			try {
+				this->_index();
+			} catch (...) {
+				Allocator::deallocate(_offsets);
+				throw;
+			}
+		}
+
+		JSONDocument(const uint8_t* bytes, size_t length) noexcept(false) : JSONDocument(Data<uint8_t>(bytes, length)) {}
+
+		JSONDocument(const String& string) noexcept(false) : JSONDocument(string.UTF8Data()) {}
+
+		JSONDocument(const JSONDocument&) = delete;
+
+		virtual ~JSONDocument() {
+			Allocator::deallocate(_offsets);
+		}
+
+		inline Value root() const {
+			return Value(this, 0, 0);
+		}
+
+		inline Value operator[](const String& key) const noexcept(false) {
+			return this->root()[key];
+		}
+
+		inline Value operator[](size_t index) const noexcept(false) {
+			return this->root()[index];
+		}
+
+	private:
+
+		Data<uint8_t> _data;
+		const uint8_t* _bytes;
+		size_t _length;
+
+		size_t* _offsets;
+		size_t _count;
+
+		// Indexes the whole document, and checks that it is one value - which is also where
+		// unclosed arrays and objects are found.
+		void _index() noexcept(false) {
+
+			_bytes = _data.items();
+			_length = _data.length();
+
+			if (_length > 2 && _bytes[0] == 0xEF && _bytes[1] == 0xBB && _bytes[2] == 0xBF) {
+				_bytes += 3;
+				_length -= 3;
+			}
+
+			JSONIndex index(_bytes, _length);
+
+			size_t capacity = 0;
+
+			for (size_t offset = index.next() ; offset < _length ; offset = index.next()) {
+				if (_count == capacity) {
+					size_t grown = math::max<size_t>(capacity * 2, _length / 8 + 64);
+					_offsets = (size_t*)Allocator::reallocate(_offsets, sizeof(size_t) * capacity, sizeof(size_t) * grown);
+					capacity = grown;
+				}
+				_offsets[_count++] = offset;
+			}
+
+			size_t end = this->_skip(0);
+
+			if (end < _count) throw DecoderException(JSON::_characters(_bytes, _offsets[end]));
+
+		}
+
+		// The byte of the structural at position - or 0 at the end of the document.
+		inline uint8_t _byte(size_t position) const {
+			return position < _count ? _bytes[_offsets[position]] : 0;
+		}
+
+		inline JSONMalformedException _malformed(size_t position) const {
+			return JSON::_malformed(_bytes, position < _count ? _offsets[position] : _length);
+		}
+
+		Type::Kind _kind(size_t position) const noexcept(false) {
+			switch (this->_byte(position)) {
+				case '{':
+					return Type::Kind::dictionary;
+				case '[':
+					return Type::Kind::array;
+				case '"':
+					return Type::Kind::string;
+				case 'n':
+					return Type::Kind::null;
+				case 't':
+				case 'f':
+				case '-':
+					return Type::Kind::number;
+				default:
+					if (this->_byte(position) >= '0' && this->_byte(position) <= '9') return Type::Kind::number;
+					throw this->_malformed(position);
+			}
+		}
+
+		// Returns the position after the value at position. Arrays and objects are stepped over
+		// by their brackets and braces alone.
+		size_t _skip(size_t position) const noexcept(false) {
+			switch (this->_kind(position)) {
+				case Type::Kind::dictionary:
+				case Type::Kind::array: {
+					size_t depth = 0;
+					for ( ; position < _count ; position++) {
+						switch (_bytes[_offsets[position]]) {
+							case '{':
+							case '[':
+								depth++;
+								break;
+							case '}':
+							case ']':
+								if (--depth == 0) return position + 1;
+								break;
+						}
+					}
+					throw this->_malformed(_count);
+				}
+				case Type::Kind::string:
+					// Both quotes are structurals.
+					if (position + 1 == _count) throw this->_malformed(_count);
+					return position + 2;
+				default:
+					return position + 1;
+			}
+		}
+
+		// Keys without escapes are compared as they are.
+		bool _isKey(size_t position, const Data<uint8_t>& encoded, const String& key) const noexcept(false) {
+			size_t start = _offsets[position] + 1;
+			size_t length = _offsets[position + 1] - start;
+			if (memchr(_bytes + start, '\\', length) == nullptr) {
+				return length == encoded.length() && memcmp(_bytes + start, encoded.items(), length) == 0;
+			}
+			return *this->_make(position, 0).as<String>() == key;
+		}
+
+		// Makes the value at position, which is nested level deep.
+		Strong<Type> _make(size_t position, size_t level) const noexcept(false) {
+			JSONIndex index(_bytes, _length, _offsets[position]);
+
+			size_t idx = index.next();
+
+			Strong<Type> result = JSON()._parse(_bytes, _length, index, &idx, level);
+
+			// Numbers and literals must end where the index has them end.
+			size_t end = this->_skip(position);
+			if (idx != (end < _count ? _offsets[end] : _length)) {
+				if (position == 0) throw DecoderException(JSON::_characters(_bytes, idx));
+				throw JSON::_malformed(_bytes, idx);
+			}
+
+			return result;
+
+		}
+
+	};
+
+}
+
+#endif /* json_document_hpp */
@@ -0,0 +1,344 @@
+//
+// json-index.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef json_index_hpp
+#define json_index_hpp
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(FART_NO_SIMD) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define FART_JSON_INDEX_X86
+#include <immintrin.h>
+#endif
+
+#include "../memory/object.hpp"
+#include "../memory/allocator.hpp"
+#include "../types/type.hpp"
+#include "../tools/math.hpp"
+
+#ifndef FART_JSON_INDEX_WINDOW
+#define FART_JSON_INDEX_WINDOW 4096
+#endif
+
+using namespace fart::memory;
+using namespace fart::types;
+using namespace fart::tools;
+
+namespace fart::serialization {
+
+	// The structural index of a JSON document: the offsets of its brackets, braces, colons and
+	// commas, of both quotes of every string, and of the first byte of every number and
+	// literal - so a parser can go from token to token without looking at whitespace or inside
+	// strings.
+	//
+	// The document is classified 64 bytes at a time into bitmasks - by AVX2 or SSE2 (picked at
+	// runtime), or one byte at a time without them. Which quotes are escaped, and so which bytes
+	// are inside strings, is then found with arithmetic on the masks. Offsets are made in
+	// windows of FART_JSON_INDEX_WINDOW bytes as they are read, so the index takes the same
+	// memory whatever the size of the document.
+	//
+	// Nothing is validated here, except that unescaped control characters inside strings are
+	// noted (see firstControl), as they cannot be seen in the index.
+	class JSONIndex : public Object {
+
+	public:
+
+		// Indexes from offset, which must not be inside a string - such as where a value starts.
+		// Offsets are still from the start of bytes.
+		JSONIndex(const uint8_t* bytes, size_t length, size_t offset = 0) noexcept(false) : _bytes(bytes), _length(length), _offsets(nullptr), _count(0), _position(0), _indexed(offset), _carries({ 0, 0, 0 }), _firstControl(NotFound) {
+			// A window has no more structurals than bytes.
+			_offsets = (size_t*)Allocator::allocate(sizeof(size_t) * math::max<size_t>(math::min<size_t>(length - offset, FART_JSON_INDEX_WINDOW), 1));
+		}
+
+		JSONIndex(const JSONIndex&) = delete;
+
+		virtual ~JSONIndex() {
+			Allocator::deallocate(_offsets);
+		}
+
+		// Returns the offset of the next structural, or the length of the document at its end.
+		inline size_t next() {
+			if (_position == _count && !_fill()) return _length;
+			return _offsets[_position++];
+		}
+
+		// Returns what next would, without moving past it.
+		inline size_t peek() {
+			if (_position == _count && !_fill()) return _length;
+			return _offsets[_position];
+		}
+
+		// The offset of the first unescaped control character in a string, in what has been
+		// indexed so far - or NotFound.
+		inline size_t firstControl() const {
+			return _firstControl;
+		}
+
+	private:
+
+		struct Masks {
+			uint64_t quotes;
+			uint64_t backslashes;
+			uint64_t operators;
+			uint64_t whiteSpaces;
+			uint64_t controls;
+		};
+
+		// What carries from one block to the next.
+		struct Carries {
+			uint64_t escaped;
+			uint64_t inString;
+			uint64_t inScalar;
+		};
+
+		const uint8_t* _bytes;
+		size_t _length;
+
+		size_t* _offsets;
+		size_t _count;
+		size_t _position;
+
+		size_t _indexed;
+		Carries _carries;
+		size_t _firstControl;
+
+		// Indexes blocks until there are offsets, or the document ends. The state is kept in
+		// locals meanwhile, as the offsets written could otherwise be its members.
+		bool _fill() {
+
+			const uint8_t* bytes = _bytes;
+			size_t length = _length;
+			size_t* offsets = _offsets;
+			size_t indexed = _indexed;
+			Carries carries = _carries;
+			size_t firstControl = _firstControl;
+
+			while (offsets == _offsets && indexed < length) {
+
+				size_t end = indexed + math::min<size_t>((length - indexed + 63) & ~(size_t)63, FART_JSON_INDEX_WINDOW);
+
+				for ( ; indexed < end ; indexed += 64) {
+
+					Masks masks;
+
+					if (length - indexed >= 64) _classify(bytes + indexed, &masks);
+					else {
+						// The last block is padded with whitespace.
+						uint8_t block[64];
+						memset(block, ' ', 64);
+						memcpy(block, bytes + indexed, length - indexed);
+						_classify(block, &masks);
+					}
+
+					uint64_t structurals = _structurals(masks, &carries);
+
+					if (masks.controls != 0 && firstControl == NotFound) firstControl = indexed + __builtin_ctzll(masks.controls);
+
+					offsets = _flatten(structurals, indexed, offsets);
+
+				}
+
+			}
+
+			_count = offsets - _offsets;
+			_position = 0;
+			_indexed = indexed;
+			_carries = carries;
+			_firstControl = firstControl;
+
+			return _count > 0;
+
+		}
+
+		// Returns the structurals of a block, and leaves only the controls inside strings.
+		static uint64_t _structurals(Masks& masks, Carries* carries) {
+
+			uint64_t quotes = masks.quotes & ~_escapedBy(masks.backslashes, carries);
+
+			// Each quote toggles whether the bytes from it are inside a string, so the opening
+			// quote is inside and the closing quote is not.
+			uint64_t inString = _prefixXor(quotes) ^ carries->inString;
+
+			// Numbers and literals are runs of anything else outside strings.
+			uint64_t scalars = ~(masks.operators | masks.whiteSpaces | quotes | inString);
+			uint64_t scalarStarts = scalars & ~((scalars << 1) | carries->inScalar);
+
+			carries->inString = (uint64_t)((int64_t)inString >> 63);
+			carries->inScalar = scalars >> 63;
+
+			masks.controls &= inString;
+
+			return (masks.operators & ~inString) | quotes | scalarStarts;
+
+		}
+
+		// The bytes escaped by backslashes - every other one in a run of them, and the byte after
+		// a run of odd length. Runs are told apart by whether they start at an odd or even bit.
+		static uint64_t _escapedBy(uint64_t backslashes, Carries* carries) {
+
+			if (backslashes == 0 && carries->escaped == 0) return 0;
+
+			const uint64_t evenBits = 0x5555555555555555ULL;
+
+			backslashes &= ~carries->escaped;
+
+			uint64_t followsEscape = (backslashes << 1) | carries->escaped;
+			uint64_t oddStarts = backslashes & ~evenBits & ~followsEscape;
+
+			uint64_t evenSequences;
+			carries->escaped = __builtin_add_overflow(oddStarts, backslashes, &evenSequences) ? 1 : 0;
+
+			return (evenBits ^ (evenSequences << 1)) & followsEscape;
+
+		}
+
+		// Sets each bit to the parity of the bits up to and including it.
+		inline static uint64_t _prefixXor(uint64_t bits) {
+			bits ^= bits << 1;
+			bits ^= bits << 2;
+			bits ^= bits << 4;
+			bits ^= bits << 8;
+			bits ^= bits << 16;
+			bits ^= bits << 32;
+			return bits;
+		}
+
+		inline static size_t* _flatten(uint64_t structurals, size_t base, size_t* offsets) {
+			while (structurals != 0) {
+				*offsets++ = base + __builtin_ctzll(structurals);
+				structurals &= structurals - 1;
+			}
+			return offsets;
+		}
+
+		static void _classify(const uint8_t* block, Masks* masks) {
+#ifdef FART_JSON_INDEX_X86
+			if (_hasAVX2()) return _classifyAVX2(block, masks);
+			return _classifySSE2(block, masks);
+#else
+			_classifyScalar(block, masks);
+#endif
+		}
+
+		static void _classifyScalar(const uint8_t* block, Masks* masks) {
+			*masks = { 0, 0, 0, 0, 0 };
+			for (size_t idx = 0 ; idx < 64 ; idx++) {
+				uint64_t bit = 1ULL << idx;
+				switch (block[idx]) {
+					case '"':
+						masks->quotes |= bit;
+						break;
+					case '\\':
+						masks->backslashes |= bit;
+						break;
+					case '{':
+					case '}':
+					case '[':
+					case ']':
+					case ':':
+					case ',':
+						masks->operators |= bit;
+						break;
+					case ' ':
+						masks->whiteSpaces |= bit;
+						break;
+					case '\t':
+					case '\n':
+					case '\r':
+						masks->whiteSpaces |= bit;
+						masks->controls |= bit;
+						break;
+					default:
+						if (block[idx] < 0x20) masks->controls |= bit;
+				}
+			}
+		}
+
+#ifdef FART_JSON_INDEX_X86
+
+		static bool _hasAVX2() {
+			static const bool result = __builtin_cpu_supports("avx2");
+			return result;
+		}
+
+		// Brackets and braces are the same with bit 5 set, so { and [ are found as one, and so
+		// are } and ].
+
+		inline static uint32_t _equalSSE2(__m128i bytes, char value) {
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value)));
+		}
+
+		static void _classifySSE2(const uint8_t* block, Masks* masks) {
+
+			*masks = { 0, 0, 0, 0, 0 };
+
+			for (size_t idx = 0 ; idx < 4 ; idx++) {
+
+				__m128i bytes = _mm_loadu_si128((const __m128i*)(block + idx * 16));
+				__m128i folded = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+
+				uint64_t quotes = _equalSSE2(bytes, '"');
+				uint64_t backslashes = _equalSSE2(bytes, '\\');
+				uint64_t operators = _equalSSE2(folded, '{') | _equalSSE2(folded, '}') | _equalSSE2(bytes, ':') | _equalSSE2(bytes, ',');
+				uint64_t whiteSpaces = _equalSSE2(bytes, ' ') | _equalSSE2(bytes, '\t') | _equalSSE2(bytes, '\n') | _equalSSE2(bytes, '\r');
+				uint64_t controls = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(bytes, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F)));
+
+				masks->quotes |= quotes << (idx * 16);
+				masks->backslashes |= backslashes << (idx * 16);
+				masks->operators |= operators << (idx * 16);
+				masks->whiteSpaces |= whiteSpaces << (idx * 16);
+				masks->controls |= controls << (idx * 16);
+
+			}
+
+		}
+
+		__attribute__((target("avx2")))
+		inline static uint32_t _equalAVX2(__m256i bytes, char value) {
+			return _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(value)));
+		}
+
+		__attribute__((target("avx2")))
+		static void _classifyAVX2(const uint8_t* block, Masks* masks) {
+
+			*masks = { 0, 0, 0, 0, 0 };
+
+			for (size_t idx = 0 ; idx < 2 ; idx++) {
+
+				__m256i bytes = _mm256_loadu_si256((const __m256i*)(block + idx * 32));
+				__m256i folded = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+
+				// Operators and whitespace are looked up by their low four bits, in tables where no
+				// other byte matches its entry.
+				const __m256i operatorTable = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0);
+				const __m256i whiteSpaceTable = _mm256_setr_epi8(' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100, ' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100);
+
+				uint64_t quotes = _equalAVX2(bytes, '"');
+				uint64_t backslashes = _equalAVX2(bytes, '\\');
+				uint64_t operators = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, _mm256_shuffle_epi8(operatorTable, folded)));
+				uint64_t whiteSpaces = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_shuffle_epi8(whiteSpaceTable, bytes)));
+				uint64_t controls = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(bytes, _mm256_set1_epi8(0x1F)), _mm256_set1_epi8(0x1F)));
+
+				masks->quotes |= quotes << (idx * 32);
+				masks->backslashes |= backslashes << (idx * 32);
+				masks->operators |= operators << (idx * 32);
+				masks->whiteSpaces |= whiteSpaces << (idx * 32);
+				masks->controls |= controls << (idx * 32);
+
+			}
+
+		}
+
+#endif
+
+	};
+
+}
+
+#endif /* json_index_hpp */
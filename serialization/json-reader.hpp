@@ -0,0 +1,614 @@
+//
+// json-reader.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef json_reader_hpp
+#define json_reader_hpp
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../memory/object.hpp"
+#include "../memory/allocator.hpp"
+#include "../exceptions/exception.hpp"
+#include "../types/data.hpp"
+#include "../types/string.hpp"
+#include "../types/number.hpp"
+#include "../tools/floating-point.hpp"
+#include "../tools/transcoder.hpp"
+#include "../tools/math.hpp"
+
+#ifndef FART_JSON_READER_MAXIMUM_DEPTH
+#define FART_JSON_READER_MAXIMUM_DEPTH 32
+#endif
+
+#ifndef FART_JSON_READER_MAXIMUM_LENGTH
+#define FART_JSON_READER_MAXIMUM_LENGTH 16777216
+#endif
+
+using namespace fart::memory;
+using namespace fart::types;
+using namespace fart::exceptions::serialization;
+using namespace fart::tools;
+
+namespace fart::serialization {
+
+	// Reads a JSON document as it arrives - in chunks of any size, such as those of
+	// Socket::accept - and tells a handler about its values as they are read, instead of
+	// building them.
+	//
+	// Memory does not grow with the document. Between chunks only the string or number that is
+	// split by them is kept, and it cannot be longer than FART_JSON_READER_MAXIMUM_LENGTH bytes.
+	// Arrays and objects take a bit each. Values cannot be nested deeper than
+	// FART_JSON_READER_MAXIMUM_DEPTH, which is the limit of JSON::parse by default.
+	//
+	// Documents are validated as JSON::parse does, and errors are thrown as it throws them -
+	// as long as the maximum depth is left at its default.
+	class JSONReader : public Object {
+
+	public:
+
+		// The values passed to a handler only live for the call, so they must be copied to be
+		// kept.
+		class Handler {
+
+		public:
+
+			virtual ~Handler() {}
+
+			virtual void startObject() {}
+			virtual void endObject() {}
+			virtual void startArray() {}
+			virtual void endArray() {}
+			virtual void key(const String&) {}
+			virtual void string(const String&) {}
+			// An Integer or a Float - whichever JSON::parse would make.
+			virtual void number(const Type&) {}
+			virtual void boolean(bool) {}
+			virtual void null() {}
+
+		};
+
+		JSONReader(Handler& handler) : _handler(handler), _token(nullptr), _tokenLength(0), _tokenCapacity(0) {
+			this->_reset();
+		}
+
+		JSONReader(const JSONReader&) = delete;
+
+		virtual ~JSONReader() {
+			Allocator::deallocate(_token);
+		}
+
+		// Reads the next length bytes of the document. A leading byte order mark is skipped, and
+		// lines and characters of errors are counted after it.
+		void read(const uint8_t* bytes, size_t length) noexcept(false) {
+
+			while (_byteOrderMark < 3 && length > 0) {
+				if (bytes[0] != (uint8_t)"\xEF\xBB\xBF"[_byteOrderMark]) {
+					if (_byteOrderMark > 0) throw JSONMalformedException(0, 0);
+					_byteOrderMark = 3;
+					break;
+				}
+				_byteOrderMark++;
+				bytes++;
+				length--;
+			}
+
+			size_t idx = 0;
+
+			// Where the bytes of the string or number at hand start in this chunk - those before
+			// it are in the token.
+			size_t run = 0;
+
+			while (idx < length) {
+
+				switch (_state) {
+					case State::value:
+						if (!this->_skipWhiteSpace(bytes, length, &idx)) break;
+						idx = this->_startValue(bytes, idx, &run);
+						break;
+					case State::valueOrEndArray:
+						if (!this->_skipWhiteSpace(bytes, length, &idx)) break;
+						if (bytes[idx] == ']') idx = this->_endContainer(bytes, idx);
+						else idx = this->_startValue(bytes, idx, &run);
+						break;
+					case State::keyOrEndObject:
+						if (!this->_skipWhiteSpace(bytes, length, &idx)) break;
+						if (bytes[idx] == '}') {
+							idx = this->_endContainer(bytes, idx);
+							break;
+						}
+						[[fallthrough]];
+					case State::key:
+						if (!this->_skipWhiteSpace(bytes, length, &idx)) break;
+						if (bytes[idx] != '"') throw this->_malformed(idx);
+						_isKey = true;
+						_state = State::string;
+						run = ++idx;
+						break;
+					case State::colon:
+						if (!this->_skipWhiteSpace(bytes, length, &idx)) break;
+						if (bytes[idx] != ':') throw this->_malformed(idx);
+						_state = State::value;
+						idx++;
+						break;
+					case State::commaOrEnd:
+						if (!this->_skipWhiteSpace(bytes, length, &idx)) break;
+						if (bytes[idx] == ',') {
+							_state = this->_inObject() ? State::key : State::value;
+							idx++;
+						}
+						else idx = this->_endContainer(bytes, idx);
+						break;
+					case State::done:
+						if (!this->_skipWhiteSpace(bytes, length, &idx)) break;
+						throw DecoderException(_offset + idx - _continuations);
+					case State::string: {
+						if (_highSurrogate != 0 && bytes[idx] != '\\') this->_appendSurrogate();
+						// Everything but quotes, backslashes, control characters and UTF-8 is
+						// itself.
+						while (idx < length && bytes[idx] >= 0x20 && bytes[idx] < 0x80 && bytes[idx] != '"' && bytes[idx] != '\\') idx++;
+						if (idx == length) break;
+						uint8_t byte = bytes[idx];
+						if (byte == '"') {
+							this->_endString(bytes + run, idx - run);
+							idx++;
+						} else if (byte == '\\') {
+							this->_buffer(bytes + run, idx - run);
+							_state = State::escape;
+							idx++;
+						} else if (byte >= 0x80) {
+							// Validated as leniently as String does.
+							if ((byte & 0xE0) == 0xC0) _remaining = 1;
+							else if ((byte & 0xF0) == 0xE0) _remaining = 2;
+							else if ((byte & 0xF8) == 0xF0) _remaining = 3;
+							else throw this->_malformed(idx);
+							_start = this->_position(idx);
+							_state = State::sequence;
+							idx++;
+						} else throw this->_malformed(idx);
+						break;
+					}
+					case State::sequence:
+						for ( ; _remaining > 0 && idx < length ; _remaining--) {
+							if ((bytes[idx] & 0xC0) != 0x80) throw this->_malformed(_start);
+							_continuations++;
+							idx++;
+						}
+						if (_remaining == 0) _state = State::string;
+						break;
+					case State::escape: {
+						uint8_t byte = bytes[idx];
+						if (byte == 'u') {
+							_start = this->_position(idx);
+							_unit = 0;
+							_digits = 0;
+							_state = State::unicode;
+							idx++;
+							break;
+						}
+						if (_highSurrogate != 0) this->_appendSurrogate();
+						switch (byte) {
+							case 'b':
+								byte = '\b';
+								break;
+							case 'f':
+								byte = '\f';
+								break;
+							case 'n':
+								byte = '\n';
+								break;
+							case 'r':
+								byte = '\r';
+								break;
+							case 't':
+								byte = '\t';
+								break;
+							case '"':
+							case '\\':
+							case '/':
+								break;
+							default:
+								throw this->_malformed(idx);
+						}
+						this->_buffer(&byte, 1);
+						_state = State::string;
+						run = ++idx;
+						break;
+					}
+					case State::unicode:
+						for ( ; _digits < 4 && idx < length ; _digits++) {
+							int32_t value = _hexValue(bytes[idx]);
+							if (value < 0) throw this->_malformed(_start);
+							_unit = (_unit << 4) | value;
+							idx++;
+						}
+						if (_digits < 4) break;
+						this->_appendUnit();
+						_state = State::string;
+						run = idx;
+						break;
+					case State::number:
+						while (idx < length && _isNumber(bytes[idx])) idx++;
+						if (idx < length) this->_endNumber(bytes + run, idx - run);
+						break;
+					case State::literal:
+						for ( ; _matched < _literalLength && idx < length ; _matched++) {
+							if (bytes[idx] != _literal[_matched]) throw this->_malformed(_start);
+							idx++;
+						}
+						if (_matched < _literalLength) break;
+						switch (_literal[0]) {
+							case 't':
+								this->_endValue();
+								_handler.boolean(true);
+								break;
+							case 'f':
+								this->_endValue();
+								_handler.boolean(false);
+								break;
+							default:
+								this->_endValue();
+								_handler.null();
+						}
+						break;
+				}
+
+			}
+
+			switch (_state) {
+				case State::string:
+				case State::sequence:
+				case State::number:
+					this->_buffer(bytes + run, length - run);
+					break;
+				default:
+					break;
+			}
+
+			_offset += length;
+
+		}
+
+		inline void read(const Data<uint8_t>& data) noexcept(false) {
+			this->read(data.items(), data.length());
+		}
+
+		// Ends the document, and throws if it is not complete. The reader can then read another.
+		void end() noexcept(false) {
+
+			switch (_state) {
+				case State::number:
+					this->_endNumber(nullptr, 0);
+					break;
+				case State::sequence:
+				case State::unicode:
+				case State::literal:
+					throw this->_malformed(_start);
+				default:
+					break;
+			}
+
+			if (_state != State::done) throw this->_malformed(_position(0));
+
+			this->_reset();
+
+		}
+
+	private:
+
+		enum class State {
+			// Before a value.
+			value,
+			// After [.
+			valueOrEndArray,
+			// After {.
+			keyOrEndObject,
+			// After a comma in an object.
+			key,
+			colon,
+			// After a value in an array or object.
+			commaOrEnd,
+			// After the document.
+			done,
+			string,
+			// After a backslash in a string.
+			escape,
+			// In the digits of a \u escape.
+			unicode,
+			// In a UTF-8 sequence in a string.
+			sequence,
+			number,
+			literal
+		};
+
+		// Where a byte is, by its offset and the UTF-8 continuation bytes before it - so lines
+		// and characters need not be counted for positions that are not thrown.
+		struct Position {
+			size_t offset;
+			size_t continuations;
+		};
+
+		Handler& _handler;
+
+		State _state;
+		bool _isKey;
+
+		// A bit for each array or object the reader is in - set for objects. Empty ones may be
+		// opened at the maximum depth.
+		uint64_t _containers[(FART_JSON_READER_MAXIMUM_DEPTH + 64) / 64];
+		size_t _depth;
+
+		// The string or number at hand, as far as it was in previous chunks - and strings with
+		// their escapes replaced.
+		uint8_t* _token;
+		size_t _tokenLength;
+		size_t _tokenCapacity;
+
+		// The start of the number, literal, \u escape or UTF-8 sequence at hand.
+		Position _start;
+
+		size_t _remaining;
+		uint32_t _unit;
+		size_t _digits;
+		uint32_t _highSurrogate;
+		const char* _literal;
+		size_t _literalLength;
+		size_t _matched;
+
+		size_t _byteOrderMark;
+		size_t _offset;
+		size_t _continuations;
+		size_t _line;
+		size_t _lineStart;
+		size_t _lineContinuations;
+
+		void _reset() {
+			_state = State::value;
+			_isKey = false;
+			_depth = 0;
+			_tokenLength = 0;
+			_start = { 0, 0 };
+			_remaining = 0;
+			_unit = 0;
+			_digits = 0;
+			_highSurrogate = 0;
+			_literal = nullptr;
+			_literalLength = 0;
+			_matched = 0;
+			_byteOrderMark = 0;
+			_offset = 0;
+			_continuations = 0;
+			_line = 0;
+			_lineStart = 0;
+			_lineContinuations = 0;
+		}
+
+		inline Position _position(size_t idx) const {
+			return { _offset + idx, _continuations };
+		}
+
+		// Lines are only broken by whitespace, so nothing that is thrown spans one.
+		JSONMalformedException _malformed(Position position, size_t characters = 0) const {
+			return JSONMalformedException(_line, position.offset - _lineStart - (position.continuations - _lineContinuations) + characters);
+		}
+
+		inline JSONMalformedException _malformed(size_t idx) const {
+			return this->_malformed(this->_position(idx));
+		}
+
+		// Skips whitespace at idx, and returns whether a byte follows it.
+		inline bool _skipWhiteSpace(const uint8_t* bytes, size_t length, size_t* idx) {
+			for ( ; *idx < length ; (*idx)++) {
+				switch (bytes[*idx]) {
+					case 0x0A:
+						_line++;
+						_lineStart = _offset + *idx + 1;
+						_lineContinuations = _continuations;
+						break;
+					case 0x20:
+					case 0x09:
+					case 0x0D:
+						break;
+					default:
+						return true;
+				}
+			}
+			return false;
+		}
+
+		// Starts the value at idx, and returns what to read next.
+		size_t _startValue(const uint8_t* bytes, size_t idx, size_t* run) {
+			if (_depth > FART_JSON_READER_MAXIMUM_DEPTH) throw this->_malformed(idx);
+			switch (bytes[idx]) {
+				case '{':
+					this->_push(true);
+					_state = State::keyOrEndObject;
+					_handler.startObject();
+					return idx + 1;
+				case '[':
+					this->_push(false);
+					_state = State::valueOrEndArray;
+					_handler.startArray();
+					return idx + 1;
+				case '"':
+					_isKey = false;
+					_state = State::string;
+					*run = idx + 1;
+					return idx + 1;
+				case 't':
+					return this->_startLiteral("true", 4, idx);
+				case 'f':
+					return this->_startLiteral("false", 5, idx);
+				case 'n':
+					return this->_startLiteral("null", 4, idx);
+				default:
+					if (bytes[idx] != '-' && (bytes[idx] < '0' || bytes[idx] > '9')) throw this->_malformed(idx);
+					_start = this->_position(idx);
+					_state = State::number;
+					*run = idx;
+					return idx;
+			}
+		}
+
+		size_t _startLiteral(const char* literal, size_t length, size_t idx) {
+			_start = this->_position(idx);
+			_literal = literal;
+			_literalLength = length;
+			_matched = 1;
+			_state = State::literal;
+			return idx + 1;
+		}
+
+		inline void _endValue() {
+			_state = _depth == 0 ? State::done : State::commaOrEnd;
+		}
+
+		void _push(bool isObject) {
+			uint64_t bit = 1ULL << (_depth % 64);
+			if (isObject) _containers[_depth / 64] |= bit;
+			else _containers[_depth / 64] &= ~bit;
+			_depth++;
+		}
+
+		inline bool _inObject() const {
+			return (_containers[(_depth - 1) / 64] >> ((_depth - 1) % 64)) & 1;
+		}
+
+		// Ends the array or object at hand with the bracket or brace at idx.
+		size_t _endContainer(const uint8_t* bytes, size_t idx) {
+			bool isObject = this->_inObject();
+			if (bytes[idx] != (isObject ? '}' : ']')) throw this->_malformed(idx);
+			_depth--;
+			this->_endValue();
+			if (isObject) _handler.endObject();
+			else _handler.endArray();
+			return idx + 1;
+		}
+
+		inline void _ensureLength(size_t length) {
+			if (length > FART_JSON_READER_MAXIMUM_LENGTH) throw JSONValueTooLongException();
+		}
+
+		void _buffer(const uint8_t* bytes, size_t length) {
+			if (length == 0) return;
+			this->_ensureLength(_tokenLength + length);
+			if (_tokenLength + length > _tokenCapacity) {
+				size_t capacity = math::max<size_t>(_tokenLength + length, _tokenCapacity * 2);
+				_token = (uint8_t*)Allocator::reallocate(_token, _tokenLength, capacity);
+				_tokenCapacity = capacity;
+			}
+			memcpy(_token + _tokenLength, bytes, length);
+			_tokenLength += length;
+		}
+
+		// Ends the string with the bytes from the chunk that are not in the token.
+		void _endString(const uint8_t* bytes, size_t length) {
+
+			if (_tokenLength > 0) {
+				this->_buffer(bytes, length);
+				bytes = _token;
+				length = _tokenLength;
+			}
+
+			this->_ensureLength(length);
+
+			String value(bytes, length);
+
+			_tokenLength = 0;
+
+			if (_isKey) {
+				_state = State::colon;
+				_handler.key(value);
+			} else {
+				this->_endValue();
+				_handler.string(value);
+			}
+
+		}
+
+		static int32_t _hexValue(uint8_t byte) {
+			if (byte >= '0' && byte <= '9') return byte - '0';
+			if (byte >= 'a' && byte <= 'f') return byte - 'a' + 10;
+			if (byte >= 'A' && byte <= 'F') return byte - 'A' + 10;
+			return -1;
+		}
+
+		void _appendCodePoint(uint32_t codePoint) {
+			uint8_t encoded[4];
+			size_t count = Transcoder::measureEncodedUTF8(&codePoint, 1);
+			Transcoder::encodeUTF8(&codePoint, 1, encoded, count);
+			this->_buffer(encoded, count);
+		}
+
+		// A high surrogate is held until the next \u escape, which is its pair if it is a low
+		// surrogate. Otherwise it is kept as is.
+		void _appendSurrogate() {
+			this->_appendCodePoint(_highSurrogate);
+			_highSurrogate = 0;
+		}
+
+		void _appendUnit() {
+			if (_highSurrogate != 0 && _unit >= 0xDC00 && _unit <= 0xDFFF) {
+				this->_appendCodePoint(0x10000 + ((_highSurrogate - 0xD800) << 10) + (_unit - 0xDC00));
+				_highSurrogate = 0;
+				return;
+			}
+			if (_highSurrogate != 0) this->_appendSurrogate();
+			if (_unit >= 0xD800 && _unit <= 0xDBFF) _highSurrogate = _unit;
+			else this->_appendCodePoint(_unit);
+		}
+
+		inline static bool _isNumber(uint8_t byte) {
+			return (byte >= '0' && byte <= '9') || byte == '-' || byte == '+' || byte == '.' || byte == 'e' || byte == 'E';
+		}
+
+		// Ends the number with the bytes from the chunk that are not in the token. The number
+		// parser looks no further than these, so it ends where JSON::parse would end it.
+		void _endNumber(const uint8_t* bytes, size_t length) {
+
+			if (_tokenLength > 0) {
+				this->_buffer(bytes, length);
+				bytes = _token;
+				length = _tokenLength;
+			}
+
+			this->_ensureLength(length);
+
+			FloatingPoint::Literal literal;
+
+			try {
+				literal = FloatingPoint::parse(bytes, length, false);
+			} catch (const DecoderException& exception) {
+				throw this->_malformed(_start, exception.characterIndex());
+			}
+
+			_tokenLength = 0;
+
+			this->_endValue();
+
+			// What the number parser left cannot follow a value.
+			if (literal.length < length) {
+				if (_state == State::done) throw DecoderException(_start.offset - _start.continuations + literal.length);
+				throw this->_malformed(_start, literal.length);
+			}
+
+			if (literal.isInteger) return _handler.number(Integer(literal.integer));
+
+			// Integers out of range would not convert.
+			if (round(literal.value) == literal.value && fabs(literal.value) < 9223372036854775808.0) return _handler.number(Integer((int64_t)literal.value));
+
+			_handler.number(Float(literal.value));
+
+		}
+
+	};
+
+}
+
+#endif /* json_reader_hpp */
@@ -0,0 +1,442 @@
+//
+// json-writer.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef json_writer_hpp
+#define json_writer_hpp
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#if !defined(FART_NO_SIMD) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define FART_JSON_WRITER_X86
+#include <immintrin.h>
+#endif
+
+#include "../memory/object.hpp"
+#include "../memory/allocator.hpp"
+#include "../exceptions/exception.hpp"
+#include "../types/type.hpp"
+#include "../types/data.hpp"
+#include "../types/string.hpp"
+#include "../types/number.hpp"
+#include "../types/dictionary.hpp"
+#include "../types/date.hpp"
+#include "../types/uuid.hpp"
+#include "../tools/floating-point.hpp"
+#include "../tools/math.hpp"
+
+#ifndef FART_JSON_WRITER_BUFFER_SIZE
+#define FART_JSON_WRITER_BUFFER_SIZE 65536
+#endif
+
+using namespace fart::memory;
+using namespace fart::types;
+using namespace fart::exceptions::serialization;
+using namespace fart::tools;
+
+namespace fart::serialization {
+
+	// Writes values as JSON in UTF-8, in one walk over them - the units of strings are escaped
+	// and encoded straight into the output, and so are numbers.
+	//
+	// Without a sink, the output is kept until taken with data(). With one, it is given to the
+	// sink in chunks of about FART_JSON_WRITER_BUFFER_SIZE bytes - such as to File::write or
+	// Socket::send - so memory does not grow with the output.
+	//
+	// What is written is what JSON::stringify writes, except that characters outside ASCII are
+	// written as they are, and not escaped. Unpaired surrogates are escaped, so the output is
+	// always valid UTF-8.
+	class JSONWriter : public Object {
+
+	public:
+
+		JSONWriter() : JSONWriter(nullptr) {}
+
+		JSONWriter(function<void(const Data<uint8_t>& data)> sink) : _sink(sink), _bytes(nullptr), _length(0), _capacity(0), _start(0) {}
+
+		JSONWriter(const JSONWriter&) = delete;
+
+		virtual ~JSONWriter() {
+			Allocator::deallocate(_bytes);
+		}
+
+		// Writes data, which is all given to the sink before returning. If it throws, what was
+		// written of data is not kept - except what was already given to the sink.
+		void write(const Type& data) noexcept(false) {
+			_start = _length;
+			this->_references = Data<void*>();
+			try {
+				this->_write(data);
+			} catch (...) {
+				_length = _start;
+				throw;
+			}
+			this->_flush();
+		}
+
+		// Takes what has been written (without a sink). The buffer is handed over, not copied.
+		Data<uint8_t> data() {
+			Data<uint8_t> result = Data<uint8_t>::_adopting(_bytes, _length, _capacity);
+			_bytes = nullptr;
+			_length = 0;
+			_capacity = 0;
+			_start = 0;
+			return result;
+		}
+
+	private:
+
+		function<void(const Data<uint8_t>& data)> _sink;
+
+		uint8_t* _bytes;
+		size_t _length;
+		size_t _capacity;
+
+		// Where the value being written starts in the buffer.
+		size_t _start;
+
+		Data<void*> _references;
+
+		// Strings are escaped in segments of this many units, so the room they need is known
+		// up front - an escape is at most six bytes.
+		static constexpr size_t _segmentLength = 4096;
+
+		void _flush() noexcept(false) {
+			if (_sink == nullptr || _length == 0) return;
+			Data<uint8_t> chunk(_bytes, _length);
+			_length = 0;
+			_start = 0;
+			_sink(chunk);
+		}
+
+		// Makes room for length more bytes, giving the buffer to the sink first if they do not fit.
+		inline void _reserve(size_t length) noexcept(false) {
+			if (_length + length <= _capacity) return;
+			this->_grow(length);
+		}
+
+		void _grow(size_t length) noexcept(false) {
+			if (_length + length > FART_JSON_WRITER_BUFFER_SIZE) this->_flush();
+			if (_length + length <= _capacity) return;
+			size_t capacity = math::max<size_t>(math::max<size_t>(_capacity * 2, _length + length), _sink != nullptr ? FART_JSON_WRITER_BUFFER_SIZE : 256);
+			_bytes = (uint8_t*)Allocator::reallocate(_bytes, _capacity, capacity);
+			_capacity = capacity;
+		}
+
+		inline void _append(uint8_t byte) noexcept(false) {
+			this->_reserve(1);
+			_bytes[_length++] = byte;
+		}
+
+		inline void _append(const char* string, size_t length) noexcept(false) {
+			this->_reserve(length);
+			memcpy(_bytes + _length, string, length);
+			_length += length;
+		}
+
+		void _write(const Type& data) noexcept(false) {
+
+			switch (data.kind()) {
+				case Type::Kind::dictionary: {
+
+					const Dictionary<Type, Type>& dictionary = data.as<Dictionary<Type, Type>>();
+
+					if (this->_references.contains((void*)&dictionary)) throw JSONEncodingCircularReferenceException();
+
+					this->_references.append((void*)&dictionary);
+
+					this->_append('{');
+
+					bool first = true;
+
+					dictionary.forEach([&](const Pair<Type, Type>& entry) {
+						if (entry.first().kind() != Type::Kind::string) throw EncoderTypeException();
+						if (!first) this->_append(',');
+						first = false;
+						this->_writeString(entry.first().as<String>());
+						this->_append(':');
+						this->_write(entry.second());
+					});
+
+					this->_append('}');
+
+					this->_references.removeLast();
+
+					break;
+				}
+				case Type::Kind::array: {
+
+					const Array<Type>& array = data.as<Array<Type>>();
+
+					if (this->_references.contains((void*)&array)) throw JSONEncodingCircularReferenceException();
+
+					this->_references.append((void*)&array);
+
+					this->_append('[');
+
+					for (size_t idx = 0 ; idx < array.count() ; idx++) {
+						if (idx > 0) this->_append(',');
+						this->_write(array[idx]);
+					}
+
+					this->_append(']');
+
+					this->_references.removeLast();
+
+					break;
+				}
+				case Type::Kind::string:
+					this->_writeString(data.as<String>());
+					break;
+				case Type::Kind::number: {
+					switch (data.as<Numeric>().subType()) {
+						case Numeric::Subtype::boolean:
+							if (data.as<types::Boolean>().value()) this->_append("true", 4);
+							else this->_append("false", 5);
+							break;
+						case Numeric::Subtype::integer:
+							this->_writeInteger(data.as<Integer>().value());
+							break;
+						case Numeric::Subtype::floatingPoint: {
+							double value = data.as<Float>().value();
+							// JSON has no infinities or NaN.
+							if (!isfinite(value)) {
+								this->_append("null", 4);
+								break;
+							}
+							this->_reserve(FloatingPoint::maximumLength);
+							_length += FloatingPoint::format(value, (char*)_bytes + _length);
+							break;
+						}
+					}
+					break;
+				}
+				case Type::Kind::null:
+					this->_append("null", 4);
+					break;
+				case Type::Kind::date:
+					this->_writeString(data.as<Date>().to(Date::TimeZone::utc).toISO8601());
+					break;
+				case Type::Kind::uuid:
+					this->_writeString(data.as<UUID>().string());
+					break;
+				default:
+					throw EncoderTypeException();
+			}
+
+		}
+
+		// Digits are made two at a time, from the end.
+		void _writeInteger(int64_t value) noexcept(false) {
+
+			static const char pairs[] =
+				"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+				"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+				"8081828384858687888990919293949596979899";
+
+			char digits[20];
+			char* position = digits + sizeof(digits);
+
+			// Negated as unsigned, so the smallest value does not overflow.
+			uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+			while (magnitude >= 100) {
+				position -= 2;
+				memcpy(position, pairs + (magnitude % 100) * 2, 2);
+				magnitude /= 100;
+			}
+
+			if (magnitude >= 10) {
+				position -= 2;
+				memcpy(position, pairs + magnitude * 2, 2);
+			} else {
+				*--position = (char)('0' + magnitude);
+			}
+
+			size_t length = digits + sizeof(digits) - position;
+
+			this->_reserve(length + 1);
+
+			if (value < 0) _bytes[_length++] = '-';
+
+			memcpy(_bytes + _length, position, length);
+			_length += length;
+
+		}
+
+		void _writeString(const String& string) noexcept(false) {
+
+			this->_append('"');
+
+			string._withUnits([&](auto units) {
+
+				size_t length = string.length();
+
+				for (size_t idx = 0 ; idx < length ; ) {
+
+					size_t end = idx + math::min<size_t>(length - idx, _segmentLength);
+
+					this->_reserve((end - idx) * 6);
+
+					uint8_t* bytes = _bytes + _length;
+
+					while (idx < end) {
+						size_t plain = _copyPlain(units + idx, end - idx, bytes);
+						bytes += plain;
+						idx += plain;
+						if (idx == end) break;
+						bytes = _writeUnit(units[idx++], bytes);
+					}
+
+					_length = bytes - _bytes;
+
+				}
+
+			});
+
+			this->_append('"');
+
+		}
+
+		// Units that are written as they are - ASCII that is not a control character, a quote or
+		// a backslash.
+		inline static bool _isPlain(uint32_t unit) {
+			return unit >= 0x20 && unit < 0x80 && unit != '"' && unit != '\\';
+		}
+
+		// Copies the plain units at the start of units into bytes (as bytes), and returns how many
+		// there were. bytes must have room for all of the units, as blocks are copied whole
+		// before they are checked.
+		template<typename U>
+		static size_t _copyPlain(const U* units, size_t length, uint8_t* bytes) {
+			size_t idx = 0;
+#ifdef FART_JSON_WRITER_X86
+			if constexpr (sizeof(U) == 1) {
+				if (_hasAVX2()) idx = _copyPlainAVX2(units, length, bytes);
+			}
+			idx = _copyPlainSSE2(units, length, bytes, idx);
+#endif
+			for ( ; idx < length && _isPlain(units[idx]) ; idx++) {
+				bytes[idx] = (uint8_t)units[idx];
+			}
+			return idx;
+		}
+
+		// Writes the escape or UTF-8 of a unit that is not plain.
+		static uint8_t* _writeUnit(uint32_t unit, uint8_t* bytes) {
+
+			switch (unit) {
+				case '\b':
+					return _writeShortEscape('b', bytes);
+				case '\f':
+					return _writeShortEscape('f', bytes);
+				case '\n':
+					return _writeShortEscape('n', bytes);
+				case '\r':
+					return _writeShortEscape('r', bytes);
+				case '\t':
+					return _writeShortEscape('t', bytes);
+				case '"':
+					return _writeShortEscape('"', bytes);
+				case '\\':
+					return _writeShortEscape('\\', bytes);
+			}
+
+			if (unit < 0x20 || (unit >= 0xD800 && unit <= 0xDFFF)) {
+				static const char hex[] = "0123456789ABCDEF";
+				bytes[0] = '\\';
+				bytes[1] = 'u';
+				bytes[2] = hex[(unit >> 12) & 0xF];
+				bytes[3] = hex[(unit >> 8) & 0xF];
+				bytes[4] = hex[(unit >> 4) & 0xF];
+				bytes[5] = hex[unit & 0xF];
+				return bytes + 6;
+			}
+
+			if (unit < 0x800) {
+				bytes[0] = (uint8_t)(0xC0 | (unit >> 6));
+				bytes[1] = (uint8_t)(0x80 | (unit & 0x3F));
+				return bytes + 2;
+			}
+
+			if (unit < 0x10000) {
+				bytes[0] = (uint8_t)(0xE0 | (unit >> 12));
+				bytes[1] = (uint8_t)(0x80 | ((unit >> 6) & 0x3F));
+				bytes[2] = (uint8_t)(0x80 | (unit & 0x3F));
+				return bytes + 3;
+			}
+
+			bytes[0] = (uint8_t)(0xF0 | (unit >> 18));
+			bytes[1] = (uint8_t)(0x80 | ((unit >> 12) & 0x3F));
+			bytes[2] = (uint8_t)(0x80 | ((unit >> 6) & 0x3F));
+			bytes[3] = (uint8_t)(0x80 | (unit & 0x3F));
+			return bytes + 4;
+
+		}
+
+		inline static uint8_t* _writeShortEscape(char character, uint8_t* bytes) {
+			bytes[0] = '\\';
+			bytes[1] = (uint8_t)character;
+			return bytes + 2;
+		}
+
+#ifdef FART_JSON_WRITER_X86
+
+		static bool _hasAVX2() {
+			static const bool result = __builtin_cpu_supports("avx2");
+			return result;
+		}
+
+		// Sixteen units narrowed to bytes. Units above a byte saturate to 0xFF or zero, which are
+		// not plain either.
+		template<typename U>
+		inline static __m128i _narrowSSE2(const U* units) {
+			if constexpr (sizeof(U) == 1) return _mm_loadu_si128((const __m128i*)units);
+			else if constexpr (sizeof(U) == 2) {
+				return _mm_packus_epi16(_mm_loadu_si128((const __m128i*)units), _mm_loadu_si128((const __m128i*)(units + 8)));
+			} else {
+				__m128i low = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)units), _mm_loadu_si128((const __m128i*)(units + 4)));
+				__m128i high = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(units + 8)), _mm_loadu_si128((const __m128i*)(units + 12)));
+				return _mm_packus_epi16(low, high);
+			}
+		}
+
+		// Bytes from 0x80 are negative, so they are below 0x20 with control characters.
+		template<typename U>
+		static size_t _copyPlainSSE2(const U* units, size_t length, uint8_t* bytes, size_t idx) {
+			for ( ; idx + 16 <= length ; idx += 16) {
+				__m128i narrowed = _narrowSSE2(units + idx);
+				__m128i escaped = _mm_or_si128(_mm_cmplt_epi8(narrowed, _mm_set1_epi8(0x20)), _mm_or_si128(_mm_cmpeq_epi8(narrowed, _mm_set1_epi8('"')), _mm_cmpeq_epi8(narrowed, _mm_set1_epi8('\\'))));
+				_mm_storeu_si128((__m128i*)(bytes + idx), narrowed);
+				uint32_t mask = _mm_movemask_epi8(escaped);
+				if (mask != 0) return idx + __builtin_ctz(mask);
+			}
+			return idx;
+		}
+
+		__attribute__((target("avx2")))
+		static size_t _copyPlainAVX2(const uint8_t* units, size_t length, uint8_t* bytes) {
+			size_t idx = 0;
+			for ( ; idx + 32 <= length ; idx += 32) {
+				__m256i block = _mm256_loadu_si256((const __m256i*)(units + idx));
+				__m256i escaped = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), block), _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\\'))));
+				_mm256_storeu_si256((__m256i*)(bytes + idx), block);
+				uint32_t mask = _mm256_movemask_epi8(escaped);
+				if (mask != 0) return idx + __builtin_ctz(mask);
+			}
+			return idx;
+		}
+
+#endif
+
+	};
+
+}
+
+#endif /* json_writer_hpp */
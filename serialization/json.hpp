@@ -16,317 +16,421 @@
 #include "../types/null.hpp"
 #include "../types/string.hpp"
 #include "../types/dictionary.hpp"
+#include "../types/atoms.hpp"
 #include "../types/duration.hpp"
 #include "../types/date.hpp"
-#include "../system/endian.hpp"
+#include "../tools/floating-point.hpp"
+#include "../tools/transcoder.hpp"
+#include "./json-index.hpp"
 
 using namespace fart::memory;
 using namespace fart::types;
 using namespace fart::exceptions::serialization;
+using namespace fart::tools;
 
 namespace fart::serialization {
 
 	class JSON: public Object {
 
+		friend class JSONDocument;
+
 	private:
 
-		inline bool _hasLength(const String& string, size_t* idx, size_t length) {
-			return *idx + length <= string.length();
-		}
+		bool _internKeys;
 
-		inline void _ensureLength(const String& string, size_t* idx, size_t length, size_t line, size_t character) {
-			if (!this->_hasLength(string, idx, length)) {
-				throw JSONMalformedException(line, character);
-			}
-		}
+		// Values nested deeper are malformed, as they could overflow the stack.
+		static constexpr size_t _maximumLevel = 32;
 
-		inline void _ensureData(const String& string, size_t* idx, size_t line, size_t character) {
-			return this->_ensureLength(string, idx, 1, line, character);
+		// Line and character are only needed for errors, so they are counted from the start when
+		// one is thrown - lines by line feeds, characters as code points since the last one.
+		static JSONMalformedException _malformed(const uint8_t* bytes, size_t idx) {
+			size_t line = 0;
+			size_t lineStart = 0;
+			for (size_t offset = 0 ; offset < idx ; offset++) {
+				if (bytes[offset] == 0x0A) {
+					line++;
+					lineStart = offset + 1;
+				}
+			}
+			return JSONMalformedException(line, _characters(bytes + lineStart, idx - lineStart));
 		}
 
-		void _offsetWhiteSpaces(const String& string, size_t* idx, size_t* line, size_t* character, bool ensure = true) {
-
-			// First we ignore any whitespaces.
-			while (string.length() > *idx && (string[*idx] == 0x20 || string[*idx] == 0x09 || string[*idx] == 0x0A || string[*idx] == 0x0D)) {
-				if (string[*idx] == 0x0A) {
-					(*line)++;
-					(*character) = 0;
-				} else {
-					(*character)++;
-				}
-				(*idx)++;
+		// The code points of (validated) UTF-8 are its bytes, except continuation bytes.
+		static size_t _characters(const uint8_t* bytes, size_t length) {
+			size_t result = 0;
+			for (size_t idx = 0 ; idx < length ; idx++) {
+				if ((bytes[idx] & 0xC0) != 0x80) result++;
 			}
+			return result;
+		}
 
-			if (ensure) this->_ensureData(string, idx, *line, *character);
+		inline void _ensureLength(const uint8_t* bytes, size_t length, size_t* idx, size_t count) {
+			if (*idx + count > length) throw _malformed(bytes, *idx);
+		}
 
+		inline void _ensureData(const uint8_t* bytes, size_t length, size_t* idx) {
+			return this->_ensureLength(bytes, length, idx, 1);
 		}
 
-		Strong<Type> _parseDictionary(const String& string, size_t* idx, size_t* line, size_t* character, size_t level) {
+		// The parser goes from structural to structural of the index, where idx is the offset of
+		// the one at hand - or the length at the end of the document. Values leave idx at what
+		// follows them.
 
-			if (string[*idx] != '{') throw JSONMalformedException(*line, *character);
+		Strong<Type> _parseDictionary(const uint8_t* bytes, size_t length, JSONIndex& index, size_t* idx, size_t level) {
 
-			(*idx)++;
-			(*character)++;
+			if (bytes[*idx] != '{') throw _malformed(bytes, *idx);
 
-			this->_ensureData(string, idx, *line, *character);
+			*idx = index.next();
 
 			Strong<Dictionary<String, Type>> result;
 
 			while (true) {
-				this->_offsetWhiteSpaces(string, idx, line, character);
-				if (string[*idx] == '}') break;
-				if (string[*idx] == ',') {
-					if (result->count() == 0) throw JSONMalformedException(*line, *character);
-					(*idx)++;
-					(*character)++;
-					this->_offsetWhiteSpaces(string, idx, line, character);
+				this->_ensureStructural(bytes, length, idx);
+				if (bytes[*idx] == '}') break;
+				if (bytes[*idx] == ',') {
+					if (result->count() == 0) throw _malformed(bytes, *idx);
+					*idx = index.next();
+					this->_ensureStructural(bytes, length, idx);
 				}
-				Strong<String> key = this->_parseString(string, idx, line, character).as<String>();
-				this->_offsetWhiteSpaces(string, idx, line, character);
-				if (string[*idx] != ':') throw JSONMalformedException(*line, *character);
-				(*idx)++;
-				(*character)++;
-				this->_offsetWhiteSpaces(string, idx, line, character);
-				Strong<Type> value = this->_parse(string, idx, line, character, level + 1);
+				Strong<String> key = this->_parseString(bytes, length, index, idx);
+				if (_internKeys) key = Atoms::intern(key);
+				this->_ensureStructural(bytes, length, idx);
+				if (bytes[*idx] != ':') throw _malformed(bytes, *idx);
+				*idx = index.next();
+				Strong<Type> value = this->_parse(bytes, length, index, idx, level + 1);
 				result->set(key, value);
-				this->_offsetWhiteSpaces(string, idx, line, character);
-				if (string[*idx] != ',' && string[*idx] != '}') throw JSONMalformedException(*line, *character);
+				this->_ensureStructural(bytes, length, idx);
+				if (bytes[*idx] != ',' && bytes[*idx] != '}') throw _malformed(bytes, *idx);
 			}
 
-			(*idx)++;
-			(*character)++;
+			*idx = index.next();
 
 			return result.as<Type>();
 
 		}
 
-		Strong<Type> _parseArray(const String& string, size_t* idx, size_t* line, size_t* character, size_t level) {
+		Strong<Type> _parseArray(const uint8_t* bytes, size_t length, JSONIndex& index, size_t* idx, size_t level) {
 
-			if (string[*idx] != '[') throw JSONMalformedException(*line, *character);
+			if (bytes[*idx] != '[') throw _malformed(bytes, *idx);
 
-			(*idx)++;
-			(*character)++;
-
-			this->_ensureData(string, idx, *line, *character);
+			*idx = index.next();
 
 			Strong<Array<Type>> result;
 
 			while (true) {
-				this->_offsetWhiteSpaces(string, idx, line, character);
-				if (string[*idx] == ']') break;
-				if (string[*idx] == ',') {
-					if (result->count() == 0) throw JSONMalformedException(*line, *character);
-					(*idx)++;
-					(*character)++;
-					this->_offsetWhiteSpaces(string, idx, line, character);
-				} else if (result->count() > 0) throw JSONMalformedException(*line, *character);
-				result->append(_parse(string, idx, line, character, level + 1));
-				this->_offsetWhiteSpaces(string, idx, line, character);
-				if (string[*idx] != ',' && string[*idx] != ']') throw JSONMalformedException(*line, *character);
+				this->_ensureStructural(bytes, length, idx);
+				if (bytes[*idx] == ']') break;
+				if (bytes[*idx] == ',') {
+					if (result->count() == 0) throw _malformed(bytes, *idx);
+					*idx = index.next();
+				} else if (result->count() > 0) throw _malformed(bytes, *idx);
+				result->append(_parse(bytes, length, index, idx, level + 1));
+				this->_ensureStructural(bytes, length, idx);
+				if (bytes[*idx] != ',' && bytes[*idx] != ']') throw _malformed(bytes, *idx);
 			}
 
-			(*idx)++;
-			(*character)++;
+			*idx = index.next();
 
 			return result.as<Type>();
 
 		}
 
-		Strong<Type> _parseNumber(const String& string, size_t* idx, size_t* line, size_t* character) {
+		inline void _ensureStructural(const uint8_t* bytes, size_t length, size_t* idx) {
+			if (*idx == length) throw _malformed(bytes, length);
+		}
+
+		// Numbers and literals end where their bytes do, which is not in the index. What follows
+		// them is the next structural - unless it follows right after, without being one.
+		static size_t _following(const uint8_t* bytes, size_t length, JSONIndex& index, size_t end) {
+			if (end < length && bytes[end] != 0x20 && bytes[end] != 0x09 && bytes[end] != 0x0A && bytes[end] != 0x0D && index.peek() != end) return end;
+			return index.next();
+		}
+
+		Strong<Type> _parseNumber(const uint8_t* bytes, size_t length, JSONIndex& index, size_t* idx) {
 
-			size_t consumed = 0;
+			FloatingPoint::Literal literal;
 
-			double value;
 			try {
-				value = string.doubleValue(*idx, &consumed, false);
-				(*idx) += consumed;
-				(*character) += consumed;
+				literal = FloatingPoint::parse(bytes + *idx, length - *idx, false);
 			} catch (const DecoderException& exception) {
-				throw JSONMalformedException(*line, *character + exception.characterIndex());
+				throw _malformed(bytes, *idx + exception.characterIndex());
 			}
 
-			if (round(value) == value) return Strong<Integer>(value).as<Type>();
+			*idx = _following(bytes, length, index, *idx + literal.length);
+
+			if (literal.isInteger) return Strong<Integer>(literal.integer).as<Type>();
 
-			return Strong<Float>(value).as<Type>();
+			// Integers out of range would not convert.
+			if (round(literal.value) == literal.value && fabs(literal.value) < 9223372036854775808.0) return Strong<Integer>(literal.value).as<Type>();
+
+			return Strong<Float>(literal.value).as<Type>();
 
 		}
 
-		Strong<Type> _parseString(const String& string, size_t* idx, size_t* line, size_t* character) {
+		// The closing quote is the next structural, so strings without escapes or control
+		// characters are made from the bytes between the quotes, and are only validated as UTF-8
+		// while being decoded. The rest are scanned byte by byte.
+		Strong<String> _parseString(const uint8_t* bytes, size_t length, JSONIndex& index, size_t* idx) {
+
+			if (bytes[*idx] != '"') throw _malformed(bytes, *idx);
+
+			size_t start = *idx + 1;
+			size_t end = index.next();
 
-			if (string[*idx] != '"') throw JSONMalformedException(*line, *character);
+			if (end < length && index.firstControl() > end && memchr(bytes + start, '\\', end - start) == nullptr) {
+				try {
+					Strong<String> result(bytes + start, end - start);
+					*idx = index.next();
+					return result;
+				} catch (const DecoderException&) {
+					// Scanned below, to throw where the malformed sequence starts.
+				}
+			}
+
+			Strong<String> result = this->_parseString(bytes, length, idx);
+
+			// The scan ends at the quote the index has.
+			if (*idx != end + 1) throw _malformed(bytes, *idx);
+
+			*idx = index.next();
+
+			return result;
+
+		}
+
+		// Scans the string at idx byte by byte, validating it on the way. Strings without escapes
+		// are made directly from their bytes, and the rest from their bytes with the escapes
+		// replaced.
+		Strong<String> _parseString(const uint8_t* bytes, size_t length, size_t* idx) {
+
+			if (bytes[*idx] != '"') throw _malformed(bytes, *idx);
 
 			(*idx)++;
-			(*character)++;
 
-			Data<uint16_t> stringBytes;
+			size_t start = *idx;
+			size_t run = start;
 
-			do {
+			Data<uint8_t> unescaped;
+			bool escaped = false;
 
-				if (string.length() == *idx) throw JSONMalformedException(*line, *character);
-				if (string[*idx] == '"') break;
+			while (true) {
 
-				switch (string[*idx]) {
-					case '\b':
-					case '\f':
-					case '\n':
-					case '\r':
-					case '\t':
-						throw JSONMalformedException(*line, *character);
+				if (length == *idx) throw _malformed(bytes, *idx);
+
+				uint8_t byte = bytes[*idx];
+
+				if (byte == '"') break;
+				if (byte < 0x20) throw _malformed(bytes, *idx);
+
+				if (byte >= 0x80) {
+					(*idx) += _validateUTF8(bytes, length, *idx);
+					continue;
+				}
+
+				if (byte != '\\') {
+					(*idx)++;
+					continue;
+				}
+
+				unescaped.append(bytes + run, *idx - run);
+				escaped = true;
+
+				(*idx)++;
+				this->_ensureData(bytes, length, idx);
+
+				switch (bytes[*idx]) {
+					case 'b':
+						unescaped.append('\b');
+						break;
+					case 'f':
+						unescaped.append('\f');
+						break;
+					case 'n':
+						unescaped.append('\n');
+						break;
+					case 'r':
+						unescaped.append('\r');
+						break;
+					case 't':
+						unescaped.append('\t');
+						break;
+					case '"':
 					case '\\':
-						(*idx)++;
-						(*character)++;
-						this->_ensureData(string, idx, *line, *character);
-						switch (string[*idx]) {
-							case 'b':
-								stringBytes.append('\b');
-								break;
-							case 'f':
-								stringBytes.append('\f');
-								break;
-							case 'n':
-								stringBytes.append('\n');
-								break;
-							case 'r':
-								stringBytes.append('\r');
-								break;
-							case 't':
-								stringBytes.append('\t');
-								break;
-							case '"':
-								stringBytes.append('"');
-								break;
-							case '\\':
-								stringBytes.append('\\');
-								break;
-							case '/':
-								stringBytes.append('/');
-								break;
-							case 'u': {
-								this->_ensureLength(string, idx, 5, *line, *character);
-								String code = string.substring(*idx + 1, 4);
-								try {
-									stringBytes.append(Endian::toSystemVariant(code.hexData()->as<uint16_t>()->itemAtIndex(0), Endian::Variant::big));
-								} catch (DecoderException&) {
-									throw JSONMalformedException(*line, *character);
-								} catch (OutOfBoundException&) {
-									throw JSONMalformedException(*line, *character);
-								}
-								(*idx) += 4;
-								(*character) += 4;
-								break;
-							}
-							default:
-								throw JSONMalformedException(*line, *character);
-						}
+					case '/':
+						unescaped.append(bytes[*idx]);
+						break;
+					case 'u':
+						this->_appendUnicodeEscape(bytes, length, idx, unescaped);
 						break;
 					default:
-						if (string[*idx] <= 0x0f) throw JSONMalformedException(*line, *character);
-						stringBytes.append(string[*idx]);
+						throw _malformed(bytes, *idx);
 				}
 
 				(*idx)++;
-				(*character)++;
+				run = *idx;
 
-			} while (true);
+			}
 
 			(*idx)++;
-			(*character)++;
 
-			return Strong<String>(stringBytes, Endian::systemVariant()).as<Type>();
+			if (!escaped) return Strong<String>(bytes + start, *idx - 1 - start);
+
+			unescaped.append(bytes + run, *idx - 1 - run);
+
+			return Strong<String>(unescaped.items(), unescaped.length());
+
+		}
+
+		// Returns the length of the UTF-8 sequence at idx - validated as leniently as String does.
+		static size_t _validateUTF8(const uint8_t* bytes, size_t length, size_t idx) {
+			uint8_t lead = bytes[idx];
+			size_t sequenceLength;
+			if ((lead & 0xE0) == 0xC0) sequenceLength = 2;
+			else if ((lead & 0xF0) == 0xE0) sequenceLength = 3;
+			else if ((lead & 0xF8) == 0xF0) sequenceLength = 4;
+			else throw _malformed(bytes, idx);
+			if (length - idx < sequenceLength) throw _malformed(bytes, idx);
+			for (size_t offset = 1 ; offset < sequenceLength ; offset++) {
+				if ((bytes[idx + offset] & 0xC0) != 0x80) throw _malformed(bytes, idx);
+			}
+			return sequenceLength;
+		}
 
+		static int32_t _hexValue(const uint8_t* bytes) {
+			int32_t result = 0;
+			for (size_t idx = 0 ; idx < 4 ; idx++) {
+				uint8_t byte = bytes[idx];
+				int32_t value;
+				if (byte >= '0' && byte <= '9') value = byte - '0';
+				else if (byte >= 'a' && byte <= 'f') value = byte - 'a' + 10;
+				else if (byte >= 'A' && byte <= 'F') value = byte - 'A' + 10;
+				else return -1;
+				result = (result << 4) | value;
+			}
+			return result;
 		}
 
-		Strong<Type> _parseLiteral(const String& string, size_t* idx, size_t* line, size_t* character) {
+		// Appends the code point of the \u escape at idx (at the u) as UTF-8, and leaves idx at its
+		// last digit. A surrogate pair is two escapes - a surrogate without its pair is kept as is.
+		void _appendUnicodeEscape(const uint8_t* bytes, size_t length, size_t* idx, Data<uint8_t>& unescaped) {
+
+			this->_ensureLength(bytes, length, idx, 5);
+
+			int32_t unit = _hexValue(bytes + *idx + 1);
+			if (unit < 0) throw _malformed(bytes, *idx);
+
+			uint32_t codePoint = unit;
+
+			(*idx) += 4;
+
+			if (unit >= 0xD800 && unit <= 0xDBFF && length - *idx > 6 && bytes[*idx + 1] == '\\' && bytes[*idx + 2] == 'u') {
+				int32_t low = _hexValue(bytes + *idx + 3);
+				if (low >= 0xDC00 && low <= 0xDFFF) {
+					codePoint = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+					(*idx) += 6;
+				}
+			}
 
-			static const String trueLiteral = "true";
-			static const String falseLiteral = "false";
-			static const String nullLiteral = "null";
+			size_t count = Transcoder::measureEncodedUTF8(&codePoint, 1);
 
-			switch (string[*idx]) {
+			unescaped.appendCBuffer([&](uint8_t* encoded, size_t) {
+				Transcoder::encodeUTF8(&codePoint, 1, encoded, count);
+				return count;
+			}, count);
+
+		}
+
+		Strong<Type> _parseLiteral(const uint8_t* bytes, size_t length, JSONIndex& index, size_t* idx) {
+
+			switch (bytes[*idx]) {
 				case 't':
-					this->_ensureLength(string, idx, 4, *line, *character);
-					if (*string.substring(*idx, 4) != trueLiteral) {
-						throw JSONMalformedException(*line, *character);
-					}
-					(*idx) += 4;
-					(*character) += 4;
+					this->_ensureLength(bytes, length, idx, 4);
+					if (memcmp(bytes + *idx, "true", 4) != 0) throw _malformed(bytes, *idx);
+					*idx = _following(bytes, length, index, *idx + 4);
 					return Strong<types::Boolean>(true).as<Type>();
 				case 'f':
-					this->_ensureLength(string, idx, 5, *line, *character);
-					if (*string.substring(*idx, 5) != falseLiteral) {
-						throw JSONMalformedException(*line, *character);
-					}
-					(*idx) += 5;
-					(*character) += 5;
+					this->_ensureLength(bytes, length, idx, 5);
+					if (memcmp(bytes + *idx, "false", 5) != 0) throw _malformed(bytes, *idx);
+					*idx = _following(bytes, length, index, *idx + 5);
 					return Strong<types::Boolean>(false).as<Type>();
 				case 'n':
-					this->_ensureLength(string, idx, 4, *line, *character);
-					if (*string.substring(*idx, 4) != nullLiteral) {
-						throw JSONMalformedException(*line, *character);
-					}
-					(*idx) += 4;
-					(*character) += 4;
+					this->_ensureLength(bytes, length, idx, 4);
+					if (memcmp(bytes + *idx, "null", 4) != 0) throw _malformed(bytes, *idx);
+					*idx = _following(bytes, length, index, *idx + 4);
 					return Strong<Null>().as<Type>();
 				default:
-					throw JSONMalformedException(*line, *character);
+					throw _malformed(bytes, *idx);
 			}
 		}
 
-		Strong<Type> _parse(const String& string, size_t* idx, size_t* line, size_t* character, size_t level) {
+		Strong<Type> _parse(const uint8_t* bytes, size_t length, JSONIndex& index, size_t* idx, size_t level) {
 
 			// Maliciously deeply nested JSON could trigger stack overflow.
-			if (level > 32) throw JSONMalformedException(*line, *character);
+			if (level > _maximumLevel) throw _malformed(bytes, *idx);
 
-			this->_offsetWhiteSpaces(string, idx, line, character);
+			this->_ensureStructural(bytes, length, idx);
 
-			uint32_t chr = string[*idx];
+			uint8_t chr = bytes[*idx];
 
 			switch (chr) {
 				case '{':
-					return this->_parseDictionary(string, idx, line, character, level);
+					return this->_parseDictionary(bytes, length, index, idx, level);
 				case '[':
-					return this->_parseArray(string, idx, line, character, level);
+					return this->_parseArray(bytes, length, index, idx, level);
 				case '"':
-					return this->_parseString(string, idx, line, character);
+					return this->_parseString(bytes, length, index, idx).as<Type>();
 				case 'n':
 				case 't':
 				case 'f':
-					return this->_parseLiteral(string, idx, line, character);
-					break;
+					return this->_parseLiteral(bytes, length, index, idx);
 				default:
 					if (chr == '-' || (chr >= '0' && chr <= '9')) {
-						return this->_parseNumber(string, idx, line, character);
+						return this->_parseNumber(bytes, length, index, idx);
 					}
-					throw JSONMalformedException(*line, *character);
+					throw _malformed(bytes, *idx);
 			}
 
 		}
 
-	public:
+		Strong<Type> _parseDocument(const uint8_t* bytes, size_t length) {
 
-		JSON() {}
-		virtual ~JSON() {}
+			JSONIndex index(bytes, length);
 
-		Strong<Type> parse(const String& string) {
+			size_t idx = index.next();
 
-			size_t idx = 0;
-			size_t line = 0;
-			size_t character = 0;
+			Strong<Type> result = this->_parse(bytes, length, index, &idx, 0);
 
-			Strong<Type> result = nullptr;
+			if (length > idx) throw DecoderException(_characters(bytes, idx));
 
-			try {
-				result = this->_parse(string, &idx, &line, &character, 0);
-			} catch (const DecoderException& exception) {
-				throw JSONMalformedException(line, character + exception.characterIndex());
-			}
+			return result;
 
-			this->_offsetWhiteSpaces(string, &idx, &line, &character, false);
+		}
 
-			if (string.length() > idx) throw DecoderException(idx);
+	public:
 
-			return result;
+		// If internKeys is set, the keys of parsed dictionaries are atoms (see Atoms) - for when
+		// many documents with the same keys are parsed.
+		JSON(bool internKeys = false) : _internKeys(internKeys) {}
+		virtual ~JSON() {}
+
+		// Parses length bytes of UTF-8 - as read from a file or a socket - without decoding them
+		// as a whole. A leading byte order mark is skipped, and lines and characters of errors
+		// are counted after it.
+		Strong<Type> parse(const uint8_t* bytes, size_t length) {
+			if (length > 2 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+				bytes += 3;
+				length -= 3;
+			}
+			return this->_parseDocument(bytes, length);
+		}
 
+		inline Strong<Type> parse(const Data<uint8_t>& data) {
+			return this->parse(data.items(), data.length());
+		}
+
+		Strong<Type> parse(const String& string) {
+			Strong<Data<uint8_t>> data = string.UTF8Data();
+			return this->_parseDocument(data->items(), data->length());
 		}
 
 		static bool isStringifiable(const Type& data) {
@@ -354,133 +458,195 @@ namespace fart::serialization {
 		}
 
 		Strong<String> stringify(const Type& data) {
-
+			String::Builder builder;
 			this->_references = Data<void*>();
+			this->_stringify(data, builder);
+			return builder.string();
+		}
 
-			Strong<String> result;
+	private:
+
+		Data<void*> _references;
+
+		void _stringify(const Type& data, String::Builder& builder) {
 
 			switch (data.kind()) {
 				case Type::Kind::dictionary: {
 
-					result->append("{");
+					const Dictionary<Type, Type>& dictionary = data.as<Dictionary<Type, Type>>();
+
+					if (this->_references.contains((void*)&dictionary)) throw JSONEncodingCircularReferenceException();
 
-					auto dictionary = data.as<Dictionary<Type, Type>>();
+					this->_references.append((void*)&dictionary);
 
-					if (this->_references.contains(&dictionary)) throw JSONEncodingCircularReferenceException();
+					builder.append('{');
 
-					this->_references.append(&dictionary);
+					bool first = true;
 
-					result->append(String::join(dictionary.keys()->map<String>([&](const Type& key) {
-						if (key.kind() != Type::Kind::string) throw EncoderTypeException();
-						Strong<String> result;
-						result->append(this->stringify(key));
-						result->append(":");
-						result->append(this->stringify(dictionary.get(key)));
-						return result;
-					}), ","));
+					dictionary.forEach([&](const Pair<Type, Type>& entry) {
+						if (entry.first().kind() != Type::Kind::string) throw EncoderTypeException();
+						if (!first) builder.append(',');
+						first = false;
+						this->_stringify(entry.first(), builder);
+						builder.append(':');
+						this->_stringify(entry.second(), builder);
+					});
+
+					builder.append('}');
 
-					result->append("}");
+					this->_references.removeLast();
 
 					break;
 				}
 				case Type::Kind::array: {
 
-					Array<Type>& array = data.as<Array<Type>>();
+					const Array<Type>& array = data.as<Array<Type>>();
+
+					if (this->_references.contains((void*)&array)) throw JSONEncodingCircularReferenceException();
 
-					if (this->_references.contains(&array)) throw JSONEncodingCircularReferenceException();
+					this->_references.append((void*)&array);
 
-					this->_references.append(&array);
+					builder.append('[');
 
-					result->append("[");
+					for (size_t idx = 0 ; idx < array.count() ; idx++) {
+						if (idx > 0) builder.append(',');
+						this->_stringify(array[idx], builder);
+					}
 
-					result->append(String::join(array.map<String>([&](const Type& item) {
-						return this->stringify(item);
-					}), ","));
+					builder.append(']');
 
-					result->append("]");
+					this->_references.removeLast();
 
 					break;
 				}
-				case Type::Kind::string: {
-					auto bytes = data.as<String>().UTF16Data(Endian::systemVariant());
-					result->append("\"");
-					for (size_t idx = 0 ; idx < bytes->length() ; idx++) {
-						auto byte = bytes->itemAtIndex(idx);
-						switch (byte) {
-							case '\b':
-								result->append("\\b");
-								break;
-							case '\f':
-								result->append("\\f");
-								break;
-							case '\n':
-								result->append("\\n");
-								break;
-							case '\r':
-								result->append("\\r");
-								break;
-							case '\t':
-								result->append("\\t");
-								break;
-							case '\"':
-								result->append("\\\"");
-								break;
-							case '\\':
-								result->append("\\\\");
-								break;
-							default:
-								if ((byte >= 0x20 && byte <= 0x7E)) {
-									result->append(byte);
-								} else {
-									uint16_t beByte = Endian::fromSystemVariant(byte, Endian::Variant::big);
-									auto beByteData = Data<uint16_t>(&beByte, 1).as<uint8_t>();
-									result->append("\\u");
-									result->append(String::fromHex(beByteData));
-								}
-								break;
-						}
-					}
-					result->append("\"");
+				case Type::Kind::string:
+					_stringifyString(data.as<String>(), builder);
 					break;
-				}
 				case Type::Kind::number: {
 					switch (data.as<Numeric>().subType()) {
 						case Numeric::Subtype::boolean:
-							result->append(data.as<types::Boolean>().value() ? "true" : "false");
+							builder.append(data.as<types::Boolean>().value() ? "true" : "false");
 							break;
 						case Numeric::Subtype::integer:
-							result->append(String::format("%lld", data.as<Integer>().value()));
+							builder.format("{}", data.as<Integer>().value());
 							break;
 						case Numeric::Subtype::floatingPoint: {
 							double value = data.as<Float>().value();
-							uint64_t length = snprintf(nullptr, 0, "%f", value);
-							char str[length + 1];
-							snprintf(str, length + 1, "%f", value);
-							result->append(str);
+							// JSON has no infinities or NaN.
+							if (!isfinite(value)) {
+								builder.append("null");
+								break;
+							}
+							char buffer[FloatingPoint::maximumLength];
+							builder.append(buffer, FloatingPoint::format(value, buffer));
 							break;
 						}
 					}
 					break;
 				}
 				case Type::Kind::null:
-					result->append("null");
+					builder.append("null");
 					break;
 				case Type::Kind::date:
-					return this->stringify(data.as<Date>().to(Date::TimeZone::utc).toISO8601());
+					_stringifyString(data.as<Date>().to(Date::TimeZone::utc).toISO8601(), builder);
 					break;
 				case Type::Kind::uuid:
-					return this->stringify(data.as<UUID>().string());
+					_stringifyString(data.as<UUID>().string(), builder);
+					break;
 				default:
 					throw EncoderTypeException();
 			}
 
-			return result;
+		}
+
+		// Printable ASCII is copied in runs, and everything else is escaped - outside ASCII as
+		// the UTF-16 of the code point.
+		static void _stringifyString(const String& string, String::Builder& builder) {
+
+			Strong<Data<uint8_t>> data = string.UTF8Data();
+			const uint8_t* bytes = data->items();
+			size_t length = data->length();
+
+			builder.append('"');
+
+			size_t run = 0;
+
+			for (size_t idx = 0 ; idx < length ; ) {
+
+				uint8_t byte = bytes[idx];
+
+				if (byte >= 0x20 && byte <= 0x7E && byte != '"' && byte != '\\') {
+					idx++;
+					continue;
+				}
+
+				builder.append((const char*)bytes + run, idx - run);
+
+				switch (byte) {
+					case '\b':
+						builder.append("\\b");
+						break;
+					case '\f':
+						builder.append("\\f");
+						break;
+					case '\n':
+						builder.append("\\n");
+						break;
+					case '\r':
+						builder.append("\\r");
+						break;
+					case '\t':
+						builder.append("\\t");
+						break;
+					case '"':
+						builder.append("\\\"");
+						break;
+					case '\\':
+						builder.append("\\\\");
+						break;
+					default: {
+						uint8_t consumed;
+						uint32_t codePoint = _decodeUTF8(bytes + idx, length - idx, &consumed);
+						if (codePoint <= 0xFFFF) {
+							_appendEscape(codePoint, builder);
+						} else {
+							codePoint -= 0x10000;
+							_appendEscape(0xD800 + ((codePoint >> 10) & 0x3FF), builder);
+							_appendEscape(0xDC00 + (codePoint & 0x3FF), builder);
+						}
+						idx += consumed;
+						run = idx;
+						continue;
+					}
+				}
+
+				idx++;
+				run = idx;
+
+			}
+
+			builder.append((const char*)bytes + run, length - run);
+			builder.append('"');
 
 		}
 
-	private:
+		// Returns the code point of the (valid) UTF-8 sequence at bytes, and sets consumed to its length.
+		static uint32_t _decodeUTF8(const uint8_t* bytes, size_t length, uint8_t* consumed) {
+			uint8_t lead = bytes[0];
+			*consumed = lead < 0x80 ? 1 : (lead < 0xE0 ? 2 : (lead < 0xF0 ? 3 : 4));
+			*consumed = math::min<size_t>(*consumed, length);
+			uint32_t codePoint = *consumed == 1 ? lead : lead & (0x7F >> *consumed);
+			for (size_t idx = 1 ; idx < *consumed ; idx++) {
+				codePoint = (codePoint << 6) | (bytes[idx] & 0x3F);
+			}
+			return codePoint;
+		}
 
-		Data<void*> _references;
+		static void _appendEscape(uint16_t unit, String::Builder& builder) {
+			static const char hex[] = "0123456789ABCDEF";
+			char escape[6] = { '\\', 'u', hex[unit >> 12], hex[(unit >> 8) & 0xF], hex[(unit >> 4) & 0xF], hex[unit & 0xF] };
+			builder.append(escape, 6);
+		}
 
 	};
 
@@ -10,5 +10,8 @@
 #define serialization_hpp
 
 #include "json.hpp"
+#include "json-reader.hpp"
+#include "json-document.hpp"
+#include "json-writer.hpp"
 
 #endif /* serialization_hpp */
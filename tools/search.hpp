@@ -0,0 +1,439 @@
+//
+// search.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef search_hpp
+#define search_hpp
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#if !defined(FART_NO_SIMD) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define FART_SEARCH_X86
+#include <immintrin.h>
+#endif
+
+#include "./math.hpp"
+
+#ifndef FART_SEARCH_TWO_WAY_LENGTH
+#define FART_SEARCH_TWO_WAY_LENGTH 32
+#endif
+
+namespace fart::tools {
+
+	// Substring search over raw item buffers. Integral items of one or four bytes are searched
+	// with SSE2 or AVX2 (picked at runtime) by filtering on the first and last item of the
+	// needle. If that produces too many false candidates, the search continues with Two-Way,
+	// which is linear in the worst case. Everything else is compared item by item.
+	class Search {
+
+	public:
+
+		static constexpr size_t notFound = math::limit<size_t>();
+
+		// A set of items, by their low byte. Wider items outside the set might share a low byte
+		// with items in it, so matches must be verified.
+		class Set {
+
+			friend class Search;
+
+		public:
+
+			Set() {
+				memset(this, 0, sizeof(Set));
+			}
+
+			template<typename T>
+			void add(T item) {
+				uint8_t byte = (uint8_t)item;
+				_bitmap[byte >> 6] |= 1ULL << (byte & 63);
+				// Nibble tables, bucketed by the high nibble.
+				_low[byte & 15] |= 1 << ((byte >> 4) & 7);
+				_high[byte >> 4] |= 1 << ((byte >> 4) & 7);
+			}
+
+			template<typename T>
+			inline bool contains(T item) const {
+				uint8_t byte = (uint8_t)item;
+				return (_bitmap[byte >> 6] >> (byte & 63)) & 1;
+			}
+
+		private:
+
+			uint64_t _bitmap[4];
+			alignas(16) uint8_t _low[16];
+			alignas(16) uint8_t _high[16];
+
+		};
+
+		template<typename T>
+		static size_t first(const T* haystack, size_t length, const T* needle, size_t needleLength) {
+
+			if (needleLength == 0) return 0;
+			if (needleLength > length) return notFound;
+
+			if constexpr (std::is_integral<T>::value && sizeof(T) == 1) {
+				return _first((const uint8_t*)haystack, length, (const uint8_t*)needle, needleLength);
+			} else if constexpr (std::is_integral<T>::value && sizeof(T) == 4) {
+				return _first((const uint32_t*)haystack, length, (const uint32_t*)needle, needleLength);
+			} else {
+				for (size_t idx = 0 ; idx <= length - needleLength ; idx++) {
+					if (equal(haystack + idx, needle, needleLength)) return idx;
+				}
+				return notFound;
+			}
+
+		}
+
+		template<typename T>
+		static size_t last(const T* haystack, size_t length, const T* needle, size_t needleLength) {
+
+			if (needleLength == 0) return length;
+			if (needleLength > length) return notFound;
+
+			for (size_t idx = length - needleLength + 1 ; idx > 0 ; idx--) {
+				if (haystack[idx - 1] != needle[0]) continue;
+				if (equal(haystack + idx - 1, needle, needleLength)) return idx - 1;
+			}
+
+			return notFound;
+
+		}
+
+		// Index of the first item in the set.
+		template<typename T>
+		static size_t firstOf(const T* haystack, size_t length, const Set& set) {
+
+			size_t idx = 0;
+
+#ifdef FART_SEARCH_X86
+			if constexpr (sizeof(T) == 1) {
+				if (_hasAVX2()) idx = _firstOfAVX2((const uint8_t*)haystack, length, set);
+				else if (_hasSSSE3()) idx = _firstOfSSSE3((const uint8_t*)haystack, length, set);
+				else idx = length;
+				if (idx < length) return idx;
+				idx -= length;
+			}
+#endif
+
+			for ( ; idx < length ; idx++) {
+				if (set.contains(haystack[idx])) return idx;
+			}
+
+			return notFound;
+
+		}
+
+		template<typename T>
+		static bool equal(const T* items, const T* other, size_t length) {
+			if constexpr (std::is_integral<T>::value) {
+				return length == 0 || memcmp(items, other, sizeof(T) * length) == 0;
+			} else {
+				for (size_t idx = 0 ; idx < length ; idx++) {
+					if (items[idx] != other[idx]) return false;
+				}
+				return true;
+			}
+		}
+
+	private:
+
+		// Items between the first and the last, which the filters have already compared.
+		inline static size_t _inner(size_t needleLength) {
+			return needleLength > 2 ? needleLength - 2 : 0;
+		}
+
+		template<typename T>
+		static size_t _first(const T* haystack, size_t length, const T* needle, size_t needleLength) {
+
+			if constexpr (sizeof(T) == 1) {
+				if (needleLength == 1) {
+					const void* found = memchr(haystack, needle[0], length);
+					return found != nullptr ? (const uint8_t*)found - haystack : notFound;
+				}
+			}
+
+			size_t idx = 0;
+
+#ifdef FART_SEARCH_X86
+			bool degenerate = false;
+			if (_hasAVX2()) idx = _filterAVX2(haystack, length, needle, needleLength, &degenerate);
+			else idx = _filterSSE2(haystack, length, needle, needleLength, &degenerate);
+			if (idx < length) return idx;
+			idx -= length;
+			if (!degenerate) return _tail(haystack, length, needle, needleLength, idx);
+#else
+			if (needleLength < FART_SEARCH_TWO_WAY_LENGTH) return _tail(haystack, length, needle, needleLength, idx);
+#endif
+
+			size_t found = _twoWay(haystack + idx, length - idx, needle, needleLength);
+			return found != notFound ? idx + found : notFound;
+
+		}
+
+		// Whatever is left after the filters, as it is too short for a full vector.
+		template<typename T>
+		static size_t _tail(const T* haystack, size_t length, const T* needle, size_t needleLength, size_t idx) {
+			for ( ; idx <= length - needleLength ; idx++) {
+				if (haystack[idx] == needle[0] && haystack[idx + needleLength - 1] == needle[needleLength - 1] && equal(haystack + idx + 1, needle + 1, _inner(needleLength))) return idx;
+			}
+			return notFound;
+		}
+
+		// Maximal suffix of the needle, by the normal or the reversed item order.
+		template<typename T>
+		static size_t _maximalSuffix(const T* needle, size_t needleLength, bool reversed, size_t* period) {
+
+			size_t suffix = notFound; // Wraps to zero below.
+			size_t idx = 0;
+			size_t offset = 1;
+			*period = 1;
+
+			while (idx + offset < needleLength) {
+				T item = needle[idx + offset];
+				T suffixItem = needle[suffix + offset];
+				if (reversed ? item > suffixItem : item < suffixItem) {
+					idx += offset;
+					offset = 1;
+					*period = idx - suffix;
+				} else if (item == suffixItem) {
+					if (offset != *period) offset++;
+					else {
+						idx += *period;
+						offset = 1;
+					}
+				} else {
+					suffix = idx++;
+					offset = *period = 1;
+				}
+			}
+
+			return suffix;
+
+		}
+
+		// Crochemore-Perrin Two-Way search.
+		template<typename T>
+		static size_t _twoWay(const T* haystack, size_t length, const T* needle, size_t needleLength) {
+
+			if (needleLength > length) return notFound;
+
+			size_t period;
+			size_t reversedPeriod;
+			size_t suffix = _maximalSuffix(needle, needleLength, false, &period);
+			size_t reversedSuffix = _maximalSuffix(needle, needleLength, true, &reversedPeriod);
+
+			// The critical factorization is the later of the two.
+			if (!(reversedSuffix + 1 < suffix + 1)) {
+				suffix = reversedSuffix;
+				period = reversedPeriod;
+			}
+			suffix++;
+
+			if (period + suffix <= needleLength && equal(needle, needle + period, suffix)) {
+
+				// Periodic needle - remember how much of the left part is known to match.
+				size_t memory = 0;
+
+				for (size_t idx = 0 ; idx <= length - needleLength ; ) {
+					size_t right = math::max(suffix, memory);
+					while (right < needleLength && needle[right] == haystack[idx + right]) right++;
+					if (right < needleLength) {
+						idx += right - suffix + 1;
+						memory = 0;
+						continue;
+					}
+					size_t left = suffix;
+					while (left > memory && needle[left - 1] == haystack[idx + left - 1]) left--;
+					if (left <= memory) return idx;
+					idx += period;
+					memory = needleLength - period;
+				}
+
+			} else {
+
+				size_t shift = math::max(suffix, needleLength - suffix) + 1;
+
+				for (size_t idx = 0 ; idx <= length - needleLength ; ) {
+					size_t right = suffix;
+					while (right < needleLength && needle[right] == haystack[idx + right]) right++;
+					if (right < needleLength) {
+						idx += right - suffix + 1;
+						continue;
+					}
+					size_t left = suffix;
+					while (left > 0 && needle[left - 1] == haystack[idx + left - 1]) left--;
+					if (left == 0) return idx;
+					idx += shift;
+				}
+
+			}
+
+			return notFound;
+
+		}
+
+#ifdef FART_SEARCH_X86
+
+		static bool _hasAVX2() {
+			static const bool result = __builtin_cpu_supports("avx2");
+			return result;
+		}
+
+		static bool _hasSSSE3() {
+			static const bool result = __builtin_cpu_supports("ssse3");
+			return result;
+		}
+
+		// Classifies bytes by looking up both nibbles, and verifies candidates in the bitmap.
+		// Like the filters, returns the length plus the index to continue from if not found.
+
+		__attribute__((target("ssse3")))
+		static size_t _firstOfSSSE3(const uint8_t* haystack, size_t length, const Set& set) {
+
+			__m128i low = _mm_load_si128((const __m128i*)set._low);
+			__m128i high = _mm_load_si128((const __m128i*)set._high);
+			__m128i nibble = _mm_set1_epi8(0x0F);
+			__m128i zero = _mm_setzero_si128();
+
+			size_t idx = 0;
+
+			for ( ; idx + 16 <= length ; idx += 16) {
+				__m128i block = _mm_loadu_si128((const __m128i*)(haystack + idx));
+				__m128i lows = _mm_shuffle_epi8(low, _mm_and_si128(block, nibble));
+				__m128i highs = _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+				uint32_t mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lows, highs), zero)) & 0xFFFF;
+				while (mask != 0) {
+					size_t candidate = idx + __builtin_ctz(mask);
+					if (set.contains(haystack[candidate])) return candidate;
+					mask &= mask - 1;
+				}
+			}
+
+			return length + idx;
+
+		}
+
+		__attribute__((target("avx2")))
+		static size_t _firstOfAVX2(const uint8_t* haystack, size_t length, const Set& set) {
+
+			__m256i low = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)set._low));
+			__m256i high = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)set._high));
+			__m256i nibble = _mm256_set1_epi8(0x0F);
+			__m256i zero = _mm256_setzero_si256();
+
+			size_t idx = 0;
+
+			for ( ; idx + 32 <= length ; idx += 32) {
+				__m256i block = _mm256_loadu_si256((const __m256i*)(haystack + idx));
+				__m256i lows = _mm256_shuffle_epi8(low, _mm256_and_si256(block, nibble));
+				__m256i highs = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+				uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lows, highs), zero));
+				while (mask != 0) {
+					size_t candidate = idx + __builtin_ctz(mask);
+					if (set.contains(haystack[candidate])) return candidate;
+					mask &= mask - 1;
+				}
+			}
+
+			return length + idx;
+
+		}
+
+		// The filters return the index of a match, or the length plus the index to continue from
+		// when there are not enough items left for a full vector, or when verifying candidates
+		// costs more than scanning (degenerate).
+
+		template<typename T>
+		static size_t _filterSSE2(const T* haystack, size_t length, const T* needle, size_t needleLength, bool* degenerate) {
+
+			constexpr size_t lanes = 16 / sizeof(T);
+
+			__m128i first = sizeof(T) == 1 ? _mm_set1_epi8((char)needle[0]) : _mm_set1_epi32((int)needle[0]);
+			__m128i last = sizeof(T) == 1 ? _mm_set1_epi8((char)needle[needleLength - 1]) : _mm_set1_epi32((int)needle[needleLength - 1]);
+
+			size_t idx = 0;
+			size_t misses = 0;
+
+			for ( ; idx + needleLength - 1 + lanes <= length ; idx += lanes) {
+
+				__m128i blockFirst = _mm_loadu_si128((const __m128i*)(haystack + idx));
+				__m128i blockLast = _mm_loadu_si128((const __m128i*)(haystack + idx + needleLength - 1));
+
+				uint32_t mask;
+
+				if constexpr (sizeof(T) == 1) {
+					mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+				} else {
+					mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(_mm_cmpeq_epi32(blockFirst, first), _mm_cmpeq_epi32(blockLast, last))));
+				}
+
+				while (mask != 0) {
+					size_t candidate = idx + __builtin_ctz(mask);
+					if (equal(haystack + candidate + 1, needle + 1, _inner(needleLength))) return candidate;
+					if (++misses * needleLength > 8 * idx + 65536) {
+						*degenerate = true;
+						return length + idx;
+					}
+					mask &= mask - 1;
+				}
+
+			}
+
+			return length + idx;
+
+		}
+
+		template<typename T>
+		__attribute__((target("avx2")))
+		static size_t _filterAVX2(const T* haystack, size_t length, const T* needle, size_t needleLength, bool* degenerate) {
+
+			constexpr size_t lanes = 32 / sizeof(T);
+
+			__m256i first = sizeof(T) == 1 ? _mm256_set1_epi8((char)needle[0]) : _mm256_set1_epi32((int)needle[0]);
+			__m256i last = sizeof(T) == 1 ? _mm256_set1_epi8((char)needle[needleLength - 1]) : _mm256_set1_epi32((int)needle[needleLength - 1]);
+
+			size_t idx = 0;
+			size_t misses = 0;
+
+			for ( ; idx + needleLength - 1 + lanes <= length ; idx += lanes) {
+
+				__m256i blockFirst = _mm256_loadu_si256((const __m256i*)(haystack + idx));
+				__m256i blockLast = _mm256_loadu_si256((const __m256i*)(haystack + idx + needleLength - 1));
+
+				uint32_t mask;
+
+				if constexpr (sizeof(T) == 1) {
+					mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+				} else {
+					mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpeq_epi32(blockFirst, first), _mm256_cmpeq_epi32(blockLast, last))));
+				}
+
+				while (mask != 0) {
+					size_t candidate = idx + __builtin_ctz(mask);
+					if (equal(haystack + candidate + 1, needle + 1, _inner(needleLength))) return candidate;
+					if (++misses * needleLength > 8 * idx + 65536) {
+						*degenerate = true;
+						return length + idx;
+					}
+					mask &= mask - 1;
+				}
+
+			}
+
+			return length + idx;
+
+		}
+
+#endif
+
+	};
+
+}
+
+#endif /* search_hpp */
@@ -10,6 +10,9 @@
 #define tools_hpp
 
 #include "./math.hpp"
+#include "./search.hpp"
+#include "./transcoder.hpp"
+#include "./floating-point.hpp"
 #include "./regular-expression.hpp"
 
 #endif /* tools_hpp */
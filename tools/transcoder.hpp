@@ -0,0 +1,1078 @@
+//
+// transcoder.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef transcoder_hpp
+#define transcoder_hpp
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(FART_NO_SIMD) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define FART_TRANSCODER_X86
+#include <immintrin.h>
+#endif
+
+#include "../exceptions/exception.hpp"
+#include "./math.hpp"
+
+using namespace fart::exceptions::types;
+
+namespace fart::tools {
+
+	// Conversion between code points and UTF-8 / UTF-16. Both ways are done in two passes:
+	// measuring validates and counts, so the second pass can write into storage of the exact
+	// size. The passes take whole blocks of 16 (SSE2) or 32 (AVX2, picked at runtime) bytes at
+	// a time, where ASCII is the fast path.
+	//
+	// UTF-8 is validated leniently, as it always has been: a sequence is malformed only if its
+	// first byte is not a valid lead, or it is not followed by the continuations it announces.
+	class Transcoder {
+
+	public:
+
+		// Returns the number of code points in buffer (from offset), and sets maximum to a value
+		// at least as large as all of them - it is only larger for overlong encodings. Throws
+		// DecoderException with the index of the first malformed sequence.
+		static size_t measureUTF8(const uint8_t* buffer, size_t length, uint32_t* maximum, size_t offset = 0) noexcept(false) {
+
+			size_t idx = offset;
+			size_t count = 0;
+			uint8_t largest = 0;
+
+#ifdef FART_TRANSCODER_X86
+			bool malformed = false;
+
+			if (_hasAVX2()) idx = _measureAVX2(buffer, length, idx, &count, &largest, &malformed);
+			else idx = _measureSSE2(buffer, length, idx, &count, &largest, &malformed);
+
+			// Measure again one by one, to know where.
+			if (malformed) return _measure(buffer, length, offset, maximum);
+
+			// The last sequence of the blocks might continue after them.
+			for (size_t back = 1 ; back <= 3 && idx >= offset + back ; back++) {
+				uint8_t byte = buffer[idx - back];
+				if ((byte & 0xC0) == 0x80) continue;
+				if (byte >= 0xC0 && back < _sequenceLength(byte)) {
+					idx -= back;
+					count--;
+				}
+				break;
+			}
+#endif
+
+			count += _measure(buffer, length, idx, maximum);
+
+			*maximum = math::max<uint32_t>(*maximum, _maximum(largest));
+
+			return count;
+
+		}
+
+		// Decodes count code points of buffer, which must have been measured, into units. Returns
+		// the code points or'ed together (ASCII might be left out, as it does not need more bits).
+		template<typename U>
+		static uint32_t decodeUTF8(const uint8_t* buffer, size_t length, U* units, size_t count) {
+#ifdef FART_TRANSCODER_X86
+			if (_hasAVX2()) return _decodeAVX2(buffer, length, units, count);
+			return _decodeSSE2(buffer, length, units, count);
+#else
+			return _decode(buffer, length, 0, units);
+#endif
+		}
+
+		// Returns the number of bytes units encode to in UTF-8. Code points above 0x1FFFFF
+		// cannot be encoded, and are left out.
+		template<typename U>
+		static size_t measureEncodedUTF8(const U* units, size_t length) {
+			size_t idx = 0;
+			size_t count = 0;
+#ifdef FART_TRANSCODER_X86
+			idx = _measureEncodedUTF8SSE2(units, length, &count);
+#endif
+			for ( ; idx < length ; idx++) {
+				count += _encodedLength(units[idx]);
+			}
+			return count;
+		}
+
+		// Encodes units into bytes, which must have room for the count measured.
+		template<typename U>
+		static void encodeUTF8(const U* units, size_t length, uint8_t* bytes, size_t count) {
+#ifdef FART_TRANSCODER_X86
+			if (_hasAVX2()) return _encodeUTF8AVX2(units, length, bytes, count);
+			return _encodeUTF8SSE2(units, length, bytes, count);
+#else
+			_encode(units, 0, length, bytes);
+#endif
+		}
+
+		// Returns the number of UTF-16 units units encode to.
+		template<typename U>
+		static size_t measureEncodedUTF16(const U* units, size_t length) {
+			if constexpr (sizeof(U) < 4) {
+				return length;
+			} else {
+				size_t idx = 0;
+				size_t count = 0;
+#ifdef FART_TRANSCODER_X86
+				idx = _measureEncodedUTF16SSE2(units, length, &count);
+#endif
+				for ( ; idx < length ; idx++) {
+					count += units[idx] > 0xFFFF ? 2 : 1;
+				}
+				return count;
+			}
+		}
+
+		// Encodes units into result, which must have room for the count measured. If swap is
+		// true, the result is in the opposite byte order of the system.
+		template<typename U>
+		static void encodeUTF16(const U* units, size_t length, uint16_t* result, bool swap) {
+			size_t idx = 0;
+#ifdef FART_TRANSCODER_X86
+			idx = _encodeUTF16SSE2(units, length, &result, swap);
+#else
+			if constexpr (sizeof(U) == 2) {
+				if (!swap) {
+					memcpy(result, units, length * sizeof(uint16_t));
+					return;
+				}
+			}
+#endif
+			for ( ; idx < length ; idx++) {
+				result = _encodeOneUTF16(units[idx], result, swap);
+			}
+		}
+
+	private:
+
+		inline static uint8_t _sequenceLength(uint8_t lead) {
+			return lead < 0xE0 ? 2 : (lead < 0xF0 ? 3 : 4);
+		}
+
+		// The largest code point a sequence led by (at most) largest can encode.
+		inline static uint32_t _maximum(uint8_t largest) {
+			if (largest < 0x80) return largest;
+			if (largest < 0xC4) return 0xFF;
+			if (largest < 0xE0) return 0x7FF;
+			if (largest < 0xF0) return 0xFFFF;
+			return 0x1FFFFF;
+		}
+
+		static size_t _measure(const uint8_t* buffer, size_t length, size_t idx, uint32_t* maximum) noexcept(false) {
+
+			size_t count = 0;
+			uint32_t bits = 0;
+
+			for ( ; idx < length ; idx++) {
+
+				const uint8_t firstByte = buffer[idx];
+				uint32_t codePoint = 0;
+				uint8_t charWidth = 1;
+
+				if ((firstByte & 0x80) == 0) {
+					codePoint = firstByte & 0x7F;
+				} else if ((firstByte & 0xE0) == 0xC0) {
+					charWidth = 2;
+					codePoint = firstByte & 0x1F;
+				} else if ((firstByte & 0xF0) == 0xE0) {
+					charWidth = 3;
+					codePoint = firstByte & 0x0F;
+				} else if ((firstByte & 0xF8) == 0xF0) {
+					charWidth = 4;
+					codePoint = firstByte & 0x07;
+				} else { // Malformed.
+					throw DecoderException(idx);
+				}
+
+				// Malformed.
+				if (length - idx < charWidth) {
+					throw DecoderException(idx);
+				}
+
+				for (size_t i = 1 ; i < charWidth ; i++) {
+					if ((buffer[idx + 1] & 0xC0) == 0x80) {
+						codePoint = (codePoint << 6) | (buffer[idx + 1] & 0x3F);
+					} else {
+						// Malformed.
+						throw DecoderException(idx);
+					}
+					idx++;
+				}
+
+				bits |= codePoint;
+				count++;
+
+			}
+
+			*maximum = bits;
+
+			return count;
+
+		}
+
+		// Decodes the (measured) sequence at idx, and moves idx past it.
+		inline static uint32_t _decodeOne(const uint8_t* buffer, size_t* idx) {
+			const uint8_t* bytes = buffer + *idx;
+			if (bytes[0] < 0x80) {
+				*idx += 1;
+				return bytes[0];
+			}
+			if (bytes[0] < 0xE0) {
+				*idx += 2;
+				return ((bytes[0] & 0x1F) << 6) | (bytes[1] & 0x3F);
+			}
+			if (bytes[0] < 0xF0) {
+				*idx += 3;
+				return ((bytes[0] & 0x0F) << 12) | ((bytes[1] & 0x3F) << 6) | (bytes[2] & 0x3F);
+			}
+			*idx += 4;
+			return ((bytes[0] & 0x07) << 18) | ((bytes[1] & 0x3F) << 12) | ((bytes[2] & 0x3F) << 6) | (bytes[3] & 0x3F);
+		}
+
+		template<typename U>
+		static uint32_t _decode(const uint8_t* buffer, size_t length, size_t idx, U* units) {
+			uint32_t bits = 0;
+			while (idx < length) {
+				uint32_t codePoint = _decodeOne(buffer, &idx);
+				if (codePoint >= 0x80) bits |= codePoint;
+				*units++ = (U)codePoint;
+			}
+			return bits;
+		}
+
+		inline static uint8_t _encodedLength(uint32_t codePoint) {
+			if (codePoint < 0x80) return 1;
+			if (codePoint < 0x800) return 2;
+			if (codePoint <= 0xFFFF) return 3;
+			if (codePoint <= 0x1FFFFF) return 4;
+			return 0;
+		}
+
+		// Encodes codePoint into bytes, and returns where the next one goes.
+		inline static uint8_t* _encodeOne(uint32_t codePoint, uint8_t* bytes) {
+			if (codePoint < 0x80) {
+				*bytes++ = codePoint;
+			} else if (codePoint < 0x800) {
+				*bytes++ = 0xC0 | (codePoint >> 6);
+				*bytes++ = 0x80 | (codePoint & 0x3F);
+			} else if (codePoint <= 0xFFFF) {
+				*bytes++ = 0xE0 | (codePoint >> 12);
+				*bytes++ = 0x80 | ((codePoint >> 6) & 0x3F);
+				*bytes++ = 0x80 | (codePoint & 0x3F);
+			} else if (codePoint <= 0x1FFFFF) {
+				*bytes++ = 0xF0 | (codePoint >> 18);
+				*bytes++ = 0x80 | ((codePoint >> 12) & 0x3F);
+				*bytes++ = 0x80 | ((codePoint >> 6) & 0x3F);
+				*bytes++ = 0x80 | (codePoint & 0x3F);
+			}
+			return bytes;
+		}
+
+		template<typename U>
+		static uint8_t* _encode(const U* units, size_t idx, size_t length, uint8_t* bytes) {
+			for ( ; idx < length ; idx++) {
+				bytes = _encodeOne(units[idx], bytes);
+			}
+			return bytes;
+		}
+
+		inline static uint16_t _swap(uint16_t unit) {
+			return (uint16_t)((unit << 8) | (unit >> 8));
+		}
+
+		inline static uint16_t* _encodeOneUTF16(uint32_t codePoint, uint16_t* result, bool swap) {
+			if (codePoint <= 0xFFFF) {
+				*result++ = swap ? _swap(codePoint) : codePoint;
+			} else {
+				codePoint -= 0x10000;
+				uint16_t high = 0xD800 + ((codePoint >> 10) & 0x3FF);
+				uint16_t low = 0xDC00 + (codePoint & 0x3FF);
+				*result++ = swap ? _swap(high) : high;
+				*result++ = swap ? _swap(low) : low;
+			}
+			return result;
+		}
+
+#ifdef FART_TRANSCODER_X86
+
+		static bool _hasAVX2() {
+			static const bool result = __builtin_cpu_supports("avx2");
+			return result;
+		}
+
+		// A sequence is well formed when every byte is a continuation exactly when one of the
+		// three before it announces it, and no byte is above 0xF7. The measurers return the index
+		// of the first byte not in a whole block.
+
+		// Without popcnt in SSE2, counts are kept in the lanes of a vector, and chunks of blocks
+		// are ended before 8 bit lanes can overflow.
+		inline static size_t _chunkEnd(size_t idx, size_t length, size_t block) {
+			return idx + math::min<size_t>((length - idx) / block, 255) * block;
+		}
+
+		inline static size_t _sum8(__m128i counts) {
+			uint64_t sums[2];
+			_mm_storeu_si128((__m128i*)sums, _mm_sad_epu8(counts, _mm_setzero_si128()));
+			return sums[0] + sums[1];
+		}
+
+		inline static int64_t _sum32(__m128i counts) {
+			int32_t sums[4];
+			_mm_storeu_si128((__m128i*)sums, counts);
+			return (int64_t)sums[0] + sums[1] + sums[2] + sums[3];
+		}
+
+		inline static __m128i _atLeast(__m128i bytes, uint8_t value) {
+			return _mm_cmpeq_epi8(_mm_max_epu8(bytes, _mm_set1_epi8((char)value)), bytes);
+		}
+
+		static size_t _measureSSE2(const uint8_t* buffer, size_t length, size_t idx, size_t* count, uint8_t* largest, bool* malformed) {
+
+			__m128i previous = _mm_setzero_si128();
+			__m128i errors = _mm_setzero_si128();
+			__m128i maximum = _mm_setzero_si128();
+
+			while (idx + 16 <= length) {
+
+				size_t end = _chunkEnd(idx, length, 16);
+				__m128i continuations = _mm_setzero_si128();
+
+				*count += end - idx;
+
+				for ( ; idx < end ; idx += 16) {
+
+					__m128i block = _mm_loadu_si128((const __m128i*)(buffer + idx));
+
+					if (_mm_movemask_epi8(_mm_or_si128(block, previous)) == 0) continue;
+
+					__m128i previous1 = _mm_or_si128(_mm_slli_si128(block, 1), _mm_srli_si128(previous, 15));
+					__m128i previous2 = _mm_or_si128(_mm_slli_si128(block, 2), _mm_srli_si128(previous, 14));
+					__m128i previous3 = _mm_or_si128(_mm_slli_si128(block, 3), _mm_srli_si128(previous, 13));
+
+					__m128i announced = _mm_or_si128(_mm_or_si128(_atLeast(previous1, 0xC0), _atLeast(previous2, 0xE0)), _atLeast(previous3, 0xF0));
+					__m128i continuation = _mm_cmpeq_epi8(_mm_and_si128(block, _mm_set1_epi8((char)0xC0)), _mm_set1_epi8((char)0x80));
+
+					errors = _mm_or_si128(errors, _mm_or_si128(_mm_xor_si128(announced, continuation), _atLeast(block, 0xF8)));
+					maximum = _mm_max_epu8(maximum, block);
+
+					continuations = _mm_sub_epi8(continuations, continuation);
+
+					previous = block;
+
+				}
+
+				*count -= _sum8(continuations);
+
+			}
+
+			*malformed = _mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) != 0xFFFF;
+
+			uint8_t bytes[16];
+			_mm_storeu_si128((__m128i*)bytes, maximum);
+			for (size_t byte = 0 ; byte < 16 ; byte++) {
+				*largest = math::max(*largest, bytes[byte]);
+			}
+
+			return idx;
+
+		}
+
+		__attribute__((target("avx2")))
+		inline static __m256i _atLeastAVX2(__m256i bytes, uint8_t value) {
+			return _mm256_cmpeq_epi8(_mm256_max_epu8(bytes, _mm256_set1_epi8((char)value)), bytes);
+		}
+
+		__attribute__((target("avx2")))
+		static size_t _measureAVX2(const uint8_t* buffer, size_t length, size_t idx, size_t* count, uint8_t* largest, bool* malformed) {
+
+			__m256i previous = _mm256_setzero_si256();
+			__m256i errors = _mm256_setzero_si256();
+			__m256i maximum = _mm256_setzero_si256();
+
+			for ( ; idx + 32 <= length ; idx += 32) {
+
+				__m256i block = _mm256_loadu_si256((const __m256i*)(buffer + idx));
+
+				if (_mm256_movemask_epi8(_mm256_or_si256(block, previous)) == 0) {
+					*count += 32;
+					continue;
+				}
+
+				// The last half of previous followed by the first half of block.
+				__m256i straddle = _mm256_permute2x128_si256(previous, block, 0x21);
+
+				__m256i previous1 = _mm256_alignr_epi8(block, straddle, 15);
+				__m256i previous2 = _mm256_alignr_epi8(block, straddle, 14);
+				__m256i previous3 = _mm256_alignr_epi8(block, straddle, 13);
+
+				__m256i announced = _mm256_or_si256(_mm256_or_si256(_atLeastAVX2(previous1, 0xC0), _atLeastAVX2(previous2, 0xE0)), _atLeastAVX2(previous3, 0xF0));
+				__m256i continuation = _mm256_cmpeq_epi8(_mm256_and_si256(block, _mm256_set1_epi8((char)0xC0)), _mm256_set1_epi8((char)0x80));
+
+				errors = _mm256_or_si256(errors, _mm256_or_si256(_mm256_xor_si256(announced, continuation), _atLeastAVX2(block, 0xF8)));
+				maximum = _mm256_max_epu8(maximum, block);
+
+				*count += 32 - __builtin_popcount((uint32_t)_mm256_movemask_epi8(continuation));
+
+				previous = block;
+
+			}
+
+			*malformed = !_mm256_testz_si256(errors, errors);
+
+			uint8_t bytes[32];
+			_mm256_storeu_si256((__m256i*)bytes, maximum);
+			for (size_t byte = 0 ; byte < 32 ; byte++) {
+				*largest = math::max(*largest, bytes[byte]);
+			}
+
+			return idx;
+
+		}
+
+		// The decoders widen blocks of ASCII straight into units. With SSE2 everything else is
+		// decoded one sequence at a time. A block with a leading run of ASCII is stored whole if
+		// there is room, as what follows the run is overwritten afterwards.
+
+		template<typename U>
+		static uint32_t _decodeSSE2(const uint8_t* buffer, size_t length, U* units, size_t count) {
+
+			const __m128i zero = _mm_setzero_si128();
+
+			U* end = units + count;
+			uint32_t bits = 0;
+			size_t idx = 0;
+
+			while (idx < length) {
+
+				if (buffer[idx] < 0x80 && idx + 16 <= length && units + 16 <= end) {
+
+					__m128i block = _mm_loadu_si128((const __m128i*)(buffer + idx));
+
+					if constexpr (sizeof(U) == 1) {
+						_mm_storeu_si128((__m128i*)units, block);
+					} else {
+						__m128i low = _mm_unpacklo_epi8(block, zero);
+						__m128i high = _mm_unpackhi_epi8(block, zero);
+						if constexpr (sizeof(U) == 2) {
+							_mm_storeu_si128((__m128i*)units, low);
+							_mm_storeu_si128((__m128i*)(units + 8), high);
+						} else {
+							_mm_storeu_si128((__m128i*)units, _mm_unpacklo_epi16(low, zero));
+							_mm_storeu_si128((__m128i*)(units + 4), _mm_unpackhi_epi16(low, zero));
+							_mm_storeu_si128((__m128i*)(units + 8), _mm_unpacklo_epi16(high, zero));
+							_mm_storeu_si128((__m128i*)(units + 12), _mm_unpackhi_epi16(high, zero));
+						}
+					}
+
+					uint32_t mask = _mm_movemask_epi8(block);
+					size_t ascii = mask == 0 ? 16 : __builtin_ctz(mask);
+
+					idx += ascii;
+					units += ascii;
+
+					continue;
+
+				}
+
+				uint32_t codePoint = _decodeOne(buffer, &idx);
+				if (codePoint >= 0x80) bits |= codePoint;
+				*units++ = (U)codePoint;
+
+			}
+
+			return bits;
+
+		}
+
+		// Shuffles moving the 16 bit lanes in a mask to the front, for every mask of eight lanes.
+		struct Compressions {
+
+			uint8_t shuffles[256][16];
+
+			Compressions() {
+				for (size_t mask = 0 ; mask < 256 ; mask++) {
+					size_t lane = 0;
+					for (size_t bit = 0 ; bit < 8 ; bit++) {
+						if (!(mask & (1 << bit))) continue;
+						shuffles[mask][lane * 2] = bit * 2;
+						shuffles[mask][lane * 2 + 1] = bit * 2 + 1;
+						lane++;
+					}
+					for ( ; lane < 8 ; lane++) {
+						shuffles[mask][lane * 2] = 0x80;
+						shuffles[mask][lane * 2 + 1] = 0x80;
+					}
+				}
+			}
+
+		};
+
+		static const Compressions& _compressions() {
+			static const Compressions compressions;
+			return compressions;
+		}
+
+		// Stores eight code points of at most 16 bits.
+		template<typename U>
+		__attribute__((target("avx2")))
+		inline static void _storeAVX2(U* units, __m128i codePoints) {
+			if constexpr (sizeof(U) == 1) _mm_storel_epi64((__m128i*)units, _mm_packus_epi16(codePoints, codePoints));
+			else if constexpr (sizeof(U) == 2) _mm_storeu_si128((__m128i*)units, codePoints);
+			else _mm256_storeu_si256((__m256i*)units, _mm256_cvtepu16_epi32(codePoints));
+		}
+
+		// Besides blocks of ASCII, blocks of 16 bytes without four byte sequences are decoded
+		// together: every byte is decoded as if it led a sequence, from the bytes after it, and
+		// only the code points at the bytes that are not continuations are kept.
+		template<typename U>
+		__attribute__((target("avx2")))
+		static uint32_t _decodeAVX2(const uint8_t* buffer, size_t length, U* units, size_t count) {
+
+			const Compressions& compressions = _compressions();
+
+			const __m128i fours = _mm_set1_epi8((char)0xF0);
+			const __m128i continuationBits = _mm_set1_epi8((char)0xC0);
+			const __m128i continuation = _mm_set1_epi8((char)0x80);
+			const __m256i low5 = _mm256_set1_epi16(0x1F);
+			const __m256i low6 = _mm256_set1_epi16(0x3F);
+			const __m256i asciiEnd = _mm256_set1_epi16(0x80);
+			const __m256i twoEnd = _mm256_set1_epi16(0xDF);
+
+			U* end = units + count;
+			__m256i bits = _mm256_setzero_si256();
+			uint32_t scalarBits = 0;
+			size_t idx = 0;
+
+			while (idx < length) {
+
+				if (idx + 32 <= length && units + 32 <= end) {
+
+					__m256i block = _mm256_loadu_si256((const __m256i*)(buffer + idx));
+
+					if (_mm256_movemask_epi8(block) == 0) {
+
+						if constexpr (sizeof(U) == 1) {
+							_mm256_storeu_si256((__m256i*)units, block);
+						} else {
+							__m128i low = _mm256_castsi256_si128(block);
+							__m128i high = _mm256_extracti128_si256(block, 1);
+							if constexpr (sizeof(U) == 2) {
+								_mm256_storeu_si256((__m256i*)units, _mm256_cvtepu8_epi16(low));
+								_mm256_storeu_si256((__m256i*)(units + 16), _mm256_cvtepu8_epi16(high));
+							} else {
+								_mm256_storeu_si256((__m256i*)units, _mm256_cvtepu8_epi32(low));
+								_mm256_storeu_si256((__m256i*)(units + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+								_mm256_storeu_si256((__m256i*)(units + 16), _mm256_cvtepu8_epi32(high));
+								_mm256_storeu_si256((__m256i*)(units + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+							}
+						}
+
+						idx += 32;
+						units += 32;
+
+						continue;
+
+					}
+
+				}
+
+				if (idx + 18 <= length && units + 16 <= end) {
+
+					__m128i block = _mm_loadu_si128((const __m128i*)(buffer + idx));
+					__m128i fourBytes = _mm_cmpeq_epi8(_mm_max_epu8(block, fours), block);
+
+					if (_mm_movemask_epi8(fourBytes) == 0) {
+
+						__m256i bytes = _mm256_cvtepu8_epi16(block);
+						__m256i next1 = _mm256_and_si256(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(buffer + idx + 1))), low6);
+						__m256i next2 = _mm256_and_si256(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(buffer + idx + 2))), low6);
+
+						__m256i two = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(bytes, low5), 6), next1);
+						__m256i three = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(bytes, 12), _mm256_slli_epi16(next1, 6)), next2);
+
+						__m256i ascii = _mm256_cmpgt_epi16(asciiEnd, bytes);
+						__m256i threes = _mm256_cmpgt_epi16(bytes, twoEnd);
+
+						__m256i codePoints = _mm256_blendv_epi8(_mm256_blendv_epi8(two, three, threes), bytes, ascii);
+
+						__m128i continuations = _mm_cmpeq_epi8(_mm_and_si128(block, continuationBits), continuation);
+						uint32_t keep = ~_mm_movemask_epi8(continuations) & 0xFFFF;
+
+						bits = _mm256_or_si256(bits, _mm256_andnot_si256(_mm256_cvtepi8_epi16(continuations), codePoints));
+
+						__m128i low = _mm_shuffle_epi8(_mm256_castsi256_si128(codePoints), _mm_loadu_si128((const __m128i*)compressions.shuffles[keep & 0xFF]));
+						__m128i high = _mm_shuffle_epi8(_mm256_extracti128_si256(codePoints, 1), _mm_loadu_si128((const __m128i*)compressions.shuffles[keep >> 8]));
+
+						_storeAVX2(units, low);
+						units += __builtin_popcount(keep & 0xFF);
+						_storeAVX2(units, high);
+						units += __builtin_popcount(keep >> 8);
+
+						// The rest of the last sequence is skipped as continuations by the next block.
+						idx += 16;
+
+						continue;
+
+					}
+
+				}
+
+				// Skip the rest of a sequence decoded by a block.
+				if ((buffer[idx] & 0xC0) == 0x80) {
+					idx++;
+					continue;
+				}
+
+				uint32_t codePoint = _decodeOne(buffer, &idx);
+				if (codePoint >= 0x80) scalarBits |= codePoint;
+				*units++ = (U)codePoint;
+
+			}
+
+			uint16_t lanes[16];
+			_mm256_storeu_si256((__m256i*)lanes, bits);
+			for (size_t lane = 0 ; lane < 16 ; lane++) {
+				scalarBits |= lanes[lane];
+			}
+
+			return scalarBits;
+
+		}
+
+		// The measurers of encoded lengths count whole blocks of 16 bytes, and return the index of
+		// the first unit not in one.
+
+		template<typename U>
+		static size_t _measureEncodedUTF8SSE2(const U* units, size_t length, size_t* count) {
+
+			constexpr size_t width = 16 / sizeof(U);
+
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t idx = 0;
+
+			while (idx + width <= length) {
+
+				size_t end = _chunkEnd(idx, length, width);
+				__m128i extra = _mm_setzero_si128();
+
+				*count += end - idx;
+
+				for ( ; idx < end ; idx += width) {
+
+					__m128i block = _mm_loadu_si128((const __m128i*)(units + idx));
+
+					if constexpr (sizeof(U) == 1) {
+						extra = _mm_sub_epi8(extra, _mm_cmplt_epi8(block, zero));
+					} else if constexpr (sizeof(U) == 2) {
+						// Units not above a limit saturate to zero, where they take one byte less.
+						__m128i one = _mm_cmpeq_epi16(_mm_subs_epu16(block, _mm_set1_epi16(0x7F)), zero);
+						__m128i two = _mm_cmpeq_epi16(_mm_subs_epu16(block, _mm_set1_epi16(0x7FF)), zero);
+						extra = _mm_add_epi16(extra, _mm_add_epi16(_mm_set1_epi16(2), _mm_add_epi16(one, two)));
+					} else {
+						// Compares are signed, so units are moved into the signed range.
+						block = _mm_xor_si128(block, _mm_set1_epi32((int)0x80000000));
+						__m128i two = _mm_cmpgt_epi32(block, _mm_set1_epi32((int)(0x7F ^ 0x80000000)));
+						__m128i three = _mm_cmpgt_epi32(block, _mm_set1_epi32((int)(0x7FF ^ 0x80000000)));
+						__m128i four = _mm_cmpgt_epi32(block, _mm_set1_epi32((int)(0xFFFF ^ 0x80000000)));
+						// Code points above 0x1FFFFF are left out.
+						__m128i none = _mm_cmpgt_epi32(block, _mm_set1_epi32((int)(0x1FFFFF ^ 0x80000000)));
+						extra = _mm_sub_epi32(extra, _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(two, three), four), _mm_slli_epi32(none, 2)));
+					}
+
+				}
+
+				if constexpr (sizeof(U) == 1) *count += _sum8(extra);
+				else if constexpr (sizeof(U) == 2) *count += _sum32(_mm_madd_epi16(extra, _mm_set1_epi16(1)));
+				else *count += _sum32(extra);
+
+			}
+
+			return idx;
+
+		}
+
+		static size_t _measureEncodedUTF16SSE2(const uint32_t* units, size_t length, size_t* count) {
+
+			const __m128i bias = _mm_set1_epi32((int)0x80000000);
+			const __m128i bmp = _mm_set1_epi32((int)(0xFFFF ^ 0x80000000));
+
+			size_t idx = 0;
+
+			while (idx + 4 <= length) {
+
+				size_t end = _chunkEnd(idx, length, 4);
+				__m128i pairs = _mm_setzero_si128();
+
+				*count += end - idx;
+
+				for ( ; idx < end ; idx += 4) {
+					__m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(units + idx)), bias);
+					pairs = _mm_sub_epi32(pairs, _mm_cmpgt_epi32(block, bmp));
+				}
+
+				*count += _sum32(pairs);
+
+			}
+
+			return idx;
+
+		}
+
+		// Narrows 16 units into bytes, and sets ascii to a mask of the ones below 0x80. The bytes of
+		// the others are undefined.
+		template<typename U>
+		inline static __m128i _narrowSSE2(const U* units, uint32_t* ascii) {
+
+			const __m128i zero = _mm_setzero_si128();
+
+			if constexpr (sizeof(U) == 1) {
+				__m128i block = _mm_loadu_si128((const __m128i*)units);
+				*ascii = ~_mm_movemask_epi8(block) & 0xFFFF;
+				return block;
+			} else if constexpr (sizeof(U) == 2) {
+				const __m128i high = _mm_set1_epi16((short)0xFF80);
+				__m128i first = _mm_loadu_si128((const __m128i*)units);
+				__m128i second = _mm_loadu_si128((const __m128i*)(units + 8));
+				*ascii = _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(first, high), zero), _mm_cmpeq_epi16(_mm_and_si128(second, high), zero)));
+				return _mm_packus_epi16(first, second);
+			} else {
+				const __m128i high = _mm_set1_epi32((int)0xFFFFFF80);
+				__m128i first = _mm_loadu_si128((const __m128i*)units);
+				__m128i second = _mm_loadu_si128((const __m128i*)(units + 4));
+				__m128i third = _mm_loadu_si128((const __m128i*)(units + 8));
+				__m128i fourth = _mm_loadu_si128((const __m128i*)(units + 12));
+				__m128i firstHalf = _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(first, high), zero), _mm_cmpeq_epi32(_mm_and_si128(second, high), zero));
+				__m128i secondHalf = _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(third, high), zero), _mm_cmpeq_epi32(_mm_and_si128(fourth, high), zero));
+				*ascii = _mm_movemask_epi8(_mm_packs_epi16(firstHalf, secondHalf));
+				return _mm_packus_epi16(_mm_packs_epi32(first, second), _mm_packs_epi32(third, fourth));
+			}
+
+		}
+
+		// With SSE2 only runs of ASCII are encoded in blocks. What follows a run in a stored block
+		// is overwritten afterwards.
+		template<typename U>
+		static void _encodeUTF8SSE2(const U* units, size_t length, uint8_t* bytes, size_t count) {
+
+			uint8_t* end = bytes + count;
+			size_t idx = 0;
+
+			while (idx < length) {
+
+				if (units[idx] < 0x80 && idx + 16 <= length && bytes + 16 <= end) {
+
+					uint32_t ascii;
+					_mm_storeu_si128((__m128i*)bytes, _narrowSSE2(units + idx, &ascii));
+
+					size_t run = ascii == 0xFFFF ? 16 : __builtin_ctz(~ascii);
+
+					idx += run;
+					bytes += run;
+
+					continue;
+
+				}
+
+				bytes = _encodeOne(units[idx++], bytes);
+
+			}
+
+		}
+
+		// Shuffles moving the bytes of encoded code points together. For eight code points of up
+		// to two bytes each, by the mask of two byte lanes, and for four code points of up to four
+		// bytes each, by their lengths less one (two bits per lane).
+		struct Expansions {
+
+			uint8_t twos[256][16];
+			uint8_t fours[256][16];
+			uint8_t fourLengths[256];
+
+			Expansions() {
+				for (size_t mask = 0 ; mask < 256 ; mask++) {
+					size_t length = 0;
+					for (size_t lane = 0 ; lane < 8 ; lane++) {
+						twos[mask][length++] = lane * 2;
+						if (mask & (1 << lane)) twos[mask][length++] = lane * 2 + 1;
+					}
+					for ( ; length < 16 ; length++) {
+						twos[mask][length] = 0x80;
+					}
+					length = 0;
+					for (size_t lane = 0 ; lane < 4 ; lane++) {
+						size_t bytes = 1 + ((mask >> (lane * 2)) & 3);
+						for (size_t byte = 0 ; byte < bytes ; byte++) {
+							fours[mask][length++] = lane * 4 + byte;
+						}
+					}
+					fourLengths[mask] = length;
+					for ( ; length < 16 ; length++) {
+						fours[mask][length] = 0x80;
+					}
+				}
+			}
+
+		};
+
+		static const Expansions& _expansions() {
+			static const Expansions expansions;
+			return expansions;
+		}
+
+		// Tells if 32 units are ASCII, and narrows them into block if they are.
+		template<typename U>
+		__attribute__((target("avx2")))
+		inline static bool _asciiAVX2(const U* units, __m256i* block) {
+			if constexpr (sizeof(U) == 1) {
+				*block = _mm256_loadu_si256((const __m256i*)units);
+				return _mm256_movemask_epi8(*block) == 0;
+			} else if constexpr (sizeof(U) == 2) {
+				__m256i first = _mm256_loadu_si256((const __m256i*)units);
+				__m256i second = _mm256_loadu_si256((const __m256i*)(units + 16));
+				if (!_mm256_testz_si256(_mm256_or_si256(first, second), _mm256_set1_epi16((short)0xFF80))) return false;
+				// Packing interleaves the halves.
+				*block = _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0xD8);
+				return true;
+			} else {
+				__m256i first = _mm256_loadu_si256((const __m256i*)units);
+				__m256i second = _mm256_loadu_si256((const __m256i*)(units + 8));
+				__m256i third = _mm256_loadu_si256((const __m256i*)(units + 16));
+				__m256i fourth = _mm256_loadu_si256((const __m256i*)(units + 24));
+				__m256i all = _mm256_or_si256(_mm256_or_si256(first, second), _mm256_or_si256(third, fourth));
+				if (!_mm256_testz_si256(all, _mm256_set1_epi32((int)0xFFFFFF80))) return false;
+				__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(first, second), _mm256_packus_epi32(third, fourth));
+				*block = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+				return true;
+			}
+		}
+
+		// Encodes 16 code points below 0x800: every one is encoded as if it took two bytes, and
+		// the bytes it does take are moved together. Stores 32 bytes.
+		__attribute__((target("avx2")))
+		inline static uint8_t* _encodeTwosAVX2(__m256i codePoints, uint8_t* bytes, const Expansions& expansions) {
+
+			__m256i two = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi16(codePoints, 6), _mm256_slli_epi16(_mm256_and_si256(codePoints, _mm256_set1_epi16(0x3F)), 8)), _mm256_set1_epi16((short)0x80C0));
+			__m256i twos = _mm256_cmpgt_epi16(codePoints, _mm256_set1_epi16(0x7F));
+
+			__m256i encoded = _mm256_blendv_epi8(codePoints, two, twos);
+
+			// Packing is done within halves, so the masks of the halves end up in bits 0-7 and 16-23.
+			uint32_t mask = _mm256_movemask_epi8(_mm256_packs_epi16(twos, twos));
+
+			uint32_t low = mask & 0xFF;
+			uint32_t high = (mask >> 16) & 0xFF;
+
+			__m256i shuffle = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)expansions.twos[low])), _mm_loadu_si128((const __m128i*)expansions.twos[high]), 1);
+
+			encoded = _mm256_shuffle_epi8(encoded, shuffle);
+
+			_mm_storeu_si128((__m128i*)bytes, _mm256_castsi256_si128(encoded));
+			bytes += 8 + __builtin_popcount(low);
+			_mm_storeu_si128((__m128i*)bytes, _mm256_extracti128_si256(encoded, 1));
+
+			return bytes + 8 + __builtin_popcount(high);
+
+		}
+
+		// Loads 16 units into 16 bit lanes, and tells if they are all below 0x800.
+		template<typename U>
+		__attribute__((target("avx2")))
+		inline static bool _twosAVX2(const U* units, __m256i* codePoints) {
+			if constexpr (sizeof(U) == 1) {
+				*codePoints = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)units));
+				return true;
+			} else if constexpr (sizeof(U) == 2) {
+				*codePoints = _mm256_loadu_si256((const __m256i*)units);
+				return _mm256_testz_si256(*codePoints, _mm256_set1_epi16((short)0xF800));
+			} else {
+				__m256i first = _mm256_loadu_si256((const __m256i*)units);
+				__m256i second = _mm256_loadu_si256((const __m256i*)(units + 8));
+				if (!_mm256_testz_si256(_mm256_or_si256(first, second), _mm256_set1_epi32((int)0xFFFFF800))) return false;
+				*codePoints = _mm256_permute4x64_epi64(_mm256_packus_epi32(first, second), 0xD8);
+				return true;
+			}
+		}
+
+		// Encodes eight code points up to 0x1FFFFF: every one is encoded as if it took four bytes,
+		// and the bytes it does take are moved together. Stores 32 bytes.
+		__attribute__((target("avx2")))
+		inline static uint8_t* _encodeFoursAVX2(__m256i codePoints, uint8_t* bytes, const Expansions& expansions) {
+
+			const __m256i low6 = _mm256_set1_epi32(0x3F);
+
+			__m256i last = _mm256_and_si256(codePoints, low6);
+			__m256i third = _mm256_and_si256(_mm256_srli_epi32(codePoints, 6), low6);
+			__m256i second = _mm256_and_si256(_mm256_srli_epi32(codePoints, 12), low6);
+
+			__m256i two = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(codePoints, 6), _mm256_slli_epi32(last, 8)), _mm256_set1_epi32(0x80C0));
+			__m256i three = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(codePoints, 12), _mm256_slli_epi32(third, 8)), _mm256_or_si256(_mm256_slli_epi32(last, 16), _mm256_set1_epi32(0x8080E0)));
+			__m256i four = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(codePoints, 18), _mm256_slli_epi32(second, 8)), _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(third, 16), _mm256_slli_epi32(last, 24)), _mm256_set1_epi32((int)0x808080F0)));
+
+			__m256i twos = _mm256_cmpgt_epi32(codePoints, _mm256_set1_epi32(0x7F));
+			__m256i threes = _mm256_cmpgt_epi32(codePoints, _mm256_set1_epi32(0x7FF));
+			__m256i fours = _mm256_cmpgt_epi32(codePoints, _mm256_set1_epi32(0xFFFF));
+
+			__m256i encoded = _mm256_blendv_epi8(_mm256_blendv_epi8(_mm256_blendv_epi8(codePoints, two, twos), three, threes), four, fours);
+
+			// The lengths less one, shifted into place and summed for each half.
+			__m256i lengths = _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_add_epi32(_mm256_add_epi32(twos, threes), fours));
+			lengths = _mm256_sad_epu8(_mm256_sllv_epi32(lengths, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)), _mm256_setzero_si256());
+			lengths = _mm256_add_epi64(lengths, _mm256_srli_si256(lengths, 8));
+
+			uint32_t low = _mm256_cvtsi256_si32(lengths);
+			uint32_t high = _mm256_extract_epi32(lengths, 4);
+
+			__m256i shuffle = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)expansions.fours[low])), _mm_loadu_si128((const __m128i*)expansions.fours[high]), 1);
+
+			encoded = _mm256_shuffle_epi8(encoded, shuffle);
+
+			_mm_storeu_si128((__m128i*)bytes, _mm256_castsi256_si128(encoded));
+			bytes += expansions.fourLengths[low];
+			_mm_storeu_si128((__m128i*)bytes, _mm256_extracti128_si256(encoded, 1));
+
+			return bytes + expansions.fourLengths[high];
+
+		}
+
+		// Besides blocks of ASCII, groups of 16 code points below 0x800, and groups of eight of
+		// any code points, are encoded together.
+		template<typename U>
+		__attribute__((target("avx2")))
+		static void _encodeUTF8AVX2(const U* units, size_t length, uint8_t* bytes, size_t count) {
+
+			const Expansions& expansions = _expansions();
+
+			uint8_t* end = bytes + count;
+			size_t idx = 0;
+
+			while (idx < length) {
+
+				if (idx + 32 <= length && bytes + 32 <= end) {
+
+					__m256i block;
+
+					if (_asciiAVX2(units + idx, &block)) {
+						_mm256_storeu_si256((__m256i*)bytes, block);
+						idx += 32;
+						bytes += 32;
+						continue;
+					}
+
+				}
+
+				if (idx + 16 <= length && bytes + 32 <= end) {
+
+					__m256i codePoints;
+
+					if (_twosAVX2(units + idx, &codePoints)) {
+						bytes = _encodeTwosAVX2(codePoints, bytes, expansions);
+						idx += 16;
+						continue;
+					}
+
+				}
+
+				// Latin-1 always fits in two bytes.
+				if constexpr (sizeof(U) > 1) {
+
+					if (idx + 8 <= length && bytes + 32 <= end) {
+
+						__m256i codePoints;
+
+						if constexpr (sizeof(U) == 2) {
+							codePoints = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(units + idx)));
+						} else {
+							codePoints = _mm256_loadu_si256((const __m256i*)(units + idx));
+						}
+
+						// Code points that cannot be encoded are left out one by one.
+						if (sizeof(U) == 2 || _mm256_testz_si256(codePoints, _mm256_set1_epi32((int)0xFFE00000))) {
+							bytes = _encodeFoursAVX2(codePoints, bytes, expansions);
+						} else {
+							bytes = _encode(units, idx, idx + 8, bytes);
+						}
+
+						idx += 8;
+
+						continue;
+
+					}
+
+				}
+
+				bytes = _encodeOne(units[idx++], bytes);
+
+			}
+
+		}
+
+		inline static __m128i _swapSSE2(__m128i units) {
+			return _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+		}
+
+		// Encodes whole blocks of UTF-16 into result, moves it past them, and returns the index
+		// of the first unit not in one.
+		template<typename U>
+		static size_t _encodeUTF16SSE2(const U* units, size_t length, uint16_t** result, bool swap) {
+
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t idx = 0;
+
+			if constexpr (sizeof(U) == 1) {
+				for ( ; idx + 16 <= length ; idx += 16) {
+					__m128i block = _mm_loadu_si128((const __m128i*)(units + idx));
+					// Swapped, the byte of a unit comes first.
+					_mm_storeu_si128((__m128i*)*result, swap ? _mm_unpacklo_epi8(zero, block) : _mm_unpacklo_epi8(block, zero));
+					_mm_storeu_si128((__m128i*)(*result + 8), swap ? _mm_unpackhi_epi8(zero, block) : _mm_unpackhi_epi8(block, zero));
+					*result += 16;
+				}
+			} else if constexpr (sizeof(U) == 2) {
+				if (!swap) {
+					memcpy(*result, units, length * sizeof(uint16_t));
+					*result += length;
+					return length;
+				}
+				for ( ; idx + 8 <= length ; idx += 8) {
+					_mm_storeu_si128((__m128i*)*result, _swapSSE2(_mm_loadu_si128((const __m128i*)(units + idx))));
+					*result += 8;
+				}
+			} else {
+				const __m128i high = _mm_set1_epi32((int)0xFFFF0000);
+				const __m128i bias = _mm_set1_epi32(0x8000);
+				const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+				for ( ; idx + 8 <= length ; idx += 8) {
+					__m128i first = _mm_loadu_si128((const __m128i*)(units + idx));
+					__m128i second = _mm_loadu_si128((const __m128i*)(units + idx + 4));
+					// Surrogate pairs are encoded one by one.
+					if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(first, second), high), zero)) != 0xFFFF) {
+						for (size_t unit = idx ; unit < idx + 8 ; unit++) {
+							*result = _encodeOneUTF16(units[unit], *result, swap);
+						}
+						continue;
+					}
+					// Packing saturates signed, so units are moved into the signed range and back.
+					__m128i packed = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(first, bias), _mm_sub_epi32(second, bias)), bias16);
+					_mm_storeu_si128((__m128i*)*result, swap ? _swapSSE2(packed) : packed);
+					*result += 8;
+				}
+			}
+
+			return idx;
+
+		}
+
+#endif
+
+	};
+
+}
+
+#endif /* transcoder_hpp */
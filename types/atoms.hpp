@@ -0,0 +1,199 @@
+//
+// atoms.hpp
+// fart
+//
+// Created by Kristian Trenskow on 2026/10/18.
+// See license in LICENSE.
+//
+
+#ifndef atoms_hpp
+#define atoms_hpp
+
+#include <stdlib.h>
+
+#include "../memory/strong.hpp"
+#include "../memory/arena.hpp"
+#include "../threading/mutex.hpp"
+#include "../tools/math.hpp"
+#include "./string.hpp"
+
+#ifndef FART_ATOMS_CAPACITY
+#define FART_ATOMS_CAPACITY 65536
+#endif
+
+#ifndef FART_ATOMS_MAXIMUM_LENGTH
+#define FART_ATOMS_MAXIMUM_LENGTH 128
+#endif
+
+using namespace fart::memory;
+using namespace fart::threading;
+using namespace fart::tools;
+
+namespace fart::types {
+
+	// A process wide table of atoms - one shared string for each contents interned, with its
+	// hash computed once. Two atoms are equal only if they are the same string, so they
+	// compare by pointer, which makes them cheap dictionary keys.
+	//
+	// Atoms live until the process exits, and must not be changed. To bound the table when
+	// interning untrusted input, strings longer than FART_ATOMS_MAXIMUM_LENGTH, and strings
+	// arriving after FART_ATOMS_CAPACITY atoms have been made, are not made atoms.
+	class Atoms {
+
+	public:
+
+		// Returns the atom with the contents of string, or a copy of string if it cannot be one.
+		static Strong<String> intern(const String& string) noexcept(false) {
+
+			if (string.isAtom()) return Strong<String>((String&)string);
+
+			if (string.length() > FART_ATOMS_MAXIMUM_LENGTH) return Strong<String>(string);
+
+			uint64_t hash = string.hash();
+
+			Shard& shard = _shards()[(hash >> 32) & (_shardCount - 1)];
+
+			Atom* atom = shard.find(string, hash);
+
+			if (atom == nullptr) atom = shard.insert(_make(string, hash), hash);
+			if (atom == nullptr) return Strong<String>(string);
+
+			return Strong<String>((String*)atom);
+
+		}
+
+		inline static Strong<String> intern(const char* string) noexcept(false) {
+			return intern(String(string));
+		}
+
+		// Returns the number of atoms.
+		static size_t count() {
+			size_t result = 0;
+			for (size_t idx = 0 ; idx < _shardCount ; idx++) {
+				result += _shards()[idx].count();
+			}
+			return result;
+		}
+
+	private:
+
+		static constexpr size_t _shardCount = 16;
+
+		class Atom : public String {
+
+		public:
+
+			using Object::retain;
+
+			Atom(const String& string, uint64_t hash) : String(), _hash(hash) {
+				// Appended, so it does not share storage with string.
+				this->append(string);
+			}
+
+			virtual uint64_t hash() const override {
+				return _hash;
+			}
+
+		private:
+
+			uint64_t _hash;
+
+		};
+
+		// An open addressing set of atoms, behind a lock.
+		class Shard {
+
+		public:
+
+			Shard() : _atoms(nullptr), _capacity(0), _count(0) {}
+
+			Atom* find(const String& string, uint64_t hash) const {
+				return _mutex.lockedValue([&]() {
+					return _find(string, hash);
+				});
+			}
+
+			// Returns the atom equal to made if another thread got there first. Otherwise made
+			// becomes an atom - unless the table is full, where nullptr is returned.
+			Atom* insert(const Strong<Atom>& made, uint64_t hash) {
+				return _mutex.lockedValue([&]() {
+					Atom* atom = _find(*made, hash);
+					if (atom != nullptr) return atom;
+					if (_count >= FART_ATOMS_CAPACITY / _shardCount || !_reserve()) return (Atom*)nullptr;
+					atom = made;
+					atom->retain();
+					Atoms::_mark(*atom);
+					size_t mask = _capacity - 1;
+					size_t slot = hash & mask;
+					while (_atoms[slot] != nullptr) slot = (slot + 1) & mask;
+					_atoms[slot] = atom;
+					_count++;
+					return atom;
+				});
+			}
+
+			size_t count() const {
+				return _mutex.lockedValue([&]() {
+					return _count;
+				});
+			}
+
+		private:
+
+			Mutex _mutex;
+			Atom** _atoms;
+			size_t _capacity;
+			size_t _count;
+
+			Atom* _find(const String& string, uint64_t hash) const {
+				if (_capacity == 0) return nullptr;
+				size_t mask = _capacity - 1;
+				for (size_t slot = hash & mask ; _atoms[slot] != nullptr ; slot = (slot + 1) & mask) {
+					if (_atoms[slot]->hash() == hash && *_atoms[slot] == string) return _atoms[slot];
+				}
+				return nullptr;
+			}
+
+			// Keeps the load factor below 1/2. Returns false if memory ran out.
+			bool _reserve() {
+				if ((_count + 1) * 2 <= _capacity) return true;
+				size_t capacity = math::max<size_t>(_capacity * 2, 64);
+				Atom** atoms = (Atom**)calloc(capacity, sizeof(Atom*));
+				if (!atoms) return false;
+				for (size_t idx = 0 ; idx < _capacity ; idx++) {
+					if (_atoms[idx] == nullptr) continue;
+					size_t slot = _atoms[idx]->hash() & (capacity - 1);
+					while (atoms[slot] != nullptr) slot = (slot + 1) & (capacity - 1);
+					atoms[slot] = _atoms[idx];
+				}
+				free(_atoms);
+				_atoms = atoms;
+				_capacity = capacity;
+				return true;
+			}
+
+		};
+
+		static_assert((_shardCount & (_shardCount - 1)) == 0);
+
+		// Made outside any arena, as atoms outlive them.
+		static Strong<Atom> _make(const String& string, uint64_t hash) noexcept(false) {
+			Arena::Scope scope(nullptr);
+			return Strong<Atom>(string, hash);
+		}
+
+		inline static void _mark(String& string) {
+			string._atom = true;
+		}
+
+		static Shard* _shards() {
+			// Intentionally never destroyed, as atoms may be used during static destruction.
+			static Shard* shards = new Shard[_shardCount];
+			return shards;
+		}
+
+	};
+
+}
+
+#endif /* atoms_hpp */
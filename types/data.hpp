@@ -15,15 +15,24 @@
 
 #include "../memory/strong.hpp"
 #include "../exceptions/exception.hpp"
+#include "../tools/search.hpp"
 #include "./type.hpp"
 #include "./array.hpp"
 
 #define MAX(x, y) (x > y ? x : y)
 
+#ifndef FART_DATA_INLINE_SIZE
+#define FART_DATA_INLINE_SIZE 32
+#endif
+
 using namespace fart::memory;
 using namespace fart::exceptions::types;
 using namespace fart::tools;
 
+namespace fart::serialization {
+	class JSONWriter;
+}
+
 namespace fart::types {
 
 	class String;
@@ -38,12 +47,16 @@ namespace fart::types {
 	template<typename T = uint8_t>
 	class Data : public Type, public Comparable<Data<T>> {
 
+		friend class fart::serialization::JSONWriter;
+
 	public:
 
 		static Type::Kind typeKind() {
 			return Type::Kind::data;
 		}
 
+		class Separators;
+
 		using Tester = function<bool(T item)>;
 		using TesterIndex = function<bool(T item, size_t idx)>;
 
@@ -54,13 +67,16 @@ namespace fart::types {
 		template<typename R>
 		using ReducerIndexStop = function<R(R result, T item, size_t idx, bool* stop)>;
 
-		static Data<T> fromCBuffer(const function<size_t(T*,size_t)>& todo, size_t length) {
-			T buffer[length];
-			size_t read = todo(buffer, length);
-			return Data<T>((T*)buffer, math::min(read, length));
+		// Lets todo write (up to length) items directly into the storage of the data. todo is
+		// called as size_t(T*, size_t), and returns the number of items written.
+		template<typename Func>
+		static Data<T> fromCBuffer(Func todo, size_t length) {
+			Data<T> result(length);
+			result._length = math::min(todo(result._pointer(), length), length);
+			return result;
 		}
 
-		Data(const T* items, size_t length) : Type(), _storage(new Storage()), _offset(0), _length(0), _size(sizeof(T)), _hashIsDirty(true), _hash(0) {
+		Data(const T* items, size_t length) : Type(), _storage(nullptr), _offset(0), _length(0), _size(sizeof(T)), _hashIsDirty(true), _hash(0), _hashStream(nullptr) {
 			append(items, length);
 		}
 
@@ -82,26 +98,38 @@ namespace fart::types {
 			}
 		}
 
-		Data(const Data<T>& other, size_t offset, size_t length) : _storage(other._storage->retain()), _offset(other._offset + offset), _length(length), _size(sizeof(T)), _hashIsDirty(offset == 0 && length == other._length), _hash(other._hash) { }
+		Data(const Data<T>& other, size_t offset, size_t length) : _storage(nullptr), _offset(0), _length(length), _size(sizeof(T)), _hashIsDirty(offset != 0 || length != other._length || other._hashIsDirty), _hash(other._hash), _hashStream(nullptr) {
+			// Short data is copied, as that is cheaper than sharing storage.
+			if (other._storage == nullptr || length <= _inlineCapacity) {
+				if (length > 0) memcpy(this->_inline, other._pointer() + offset, sizeof(T) * length);
+			} else {
+				this->_storage = other._storage->retain();
+				this->_offset = other._offset + offset;
+			}
+		}
 
 		Data(const Data<T>& other) : Data(other, 0, other._length) { }
 
 		Data(Data<T>&& other) : Type() {
+			if (other._storage == nullptr) memcpy(this->_inline, other._inline, sizeof(T) * other._length);
 			this->_storage = other._storage;
 			this->_offset = other._offset;
 			this->_length = other._length;
 			this->_size = other._size;
 			this->_hashIsDirty = other._hashIsDirty;
 			this->_hash = other._hash;
+			this->_hashStream = other._hashStream;
 			other._storage = nullptr;
 			other._offset = 0;
 			other._length = 0;
 			other._size = 0;
 			other._hashIsDirty = true;
+			other._hashStream = nullptr;
 		}
 
 		virtual ~Data() {
 			Storage::release(&this->_storage);
+			delete this->_hashStream;
 			this->_offset = 0;
 			this->_length = 0;
 			this->_size = 0;
@@ -120,6 +148,20 @@ namespace fart::types {
 			append(data.items(), data.length());
 		}
 
+		// Lets todo write (up to length) items directly after the items of the data. todo is
+		// called as size_t(T*, size_t), and returns the number of items written.
+		template<typename Func>
+		void appendCBuffer(Func todo, size_t length) {
+			this->_ensureStorageSize(this->_length + length);
+			this->_length += math::min(todo(this->_pointer() + this->_length, length), length);
+			this->_invalidateHash(true);
+		}
+
+		// Makes room for capacity items, so appending up to that many does not grow the storage.
+		inline void reserve(size_t capacity) {
+			this->_ensureStorageSize(capacity);
+		}
+
 		inline Strong<Data<T>> appending(T element) {
 			Strong<Data<T>> result = *this;
 			result->append(element);
@@ -140,12 +182,17 @@ namespace fart::types {
 
 			T element = this->_get(index);
 
-			for (size_t idx = index ; idx < this->length() - 1 ; idx++) {
-				this->_set(idx, this->_get(idx + 1));
+			if constexpr (is_trivially_copyable<T>::value) {
+				T* pointer = this->_pointer();
+				memmove(pointer + index, pointer + index + 1, sizeof(T) * (this->length() - index - 1));
+			} else {
+				for (size_t idx = index ; idx < this->length() - 1 ; idx++) {
+					this->_set(idx, this->_get(idx + 1));
+				}
 			}
 
 			this->_length--;
-			_hashIsDirty = true;
+			this->_invalidateHash();
 
 			return element;
 
@@ -166,17 +213,24 @@ namespace fart::types {
 
 			T src = this->_get(srcIndex);
 
-			if (srcIndex < dstIndex) {
-				for (size_t idx = srcIndex + 1 ; idx <= dstIndex ; idx++) {
-					this->_set(idx - 1, this->_get(idx));
-				}
+			if constexpr (is_trivially_copyable<T>::value) {
+				T* pointer = this->_pointer();
+				if (srcIndex < dstIndex) memmove(pointer + srcIndex, pointer + srcIndex + 1, sizeof(T) * (dstIndex - srcIndex));
+				else memmove(pointer + dstIndex + 1, pointer + dstIndex, sizeof(T) * (srcIndex - dstIndex));
 			} else {
-				for (size_t idx = srcIndex ; idx > dstIndex ; idx--) {
-					this->_set(idx, this->_get(idx - 1));
+				if (srcIndex < dstIndex) {
+					for (size_t idx = srcIndex + 1 ; idx <= dstIndex ; idx++) {
+						this->_set(idx - 1, this->_get(idx));
+					}
+				} else {
+					for (size_t idx = srcIndex ; idx > dstIndex ; idx--) {
+						this->_set(idx, this->_get(idx - 1));
+					}
 				}
 			}
 
 			this->_set(dstIndex, src);
+			this->_invalidateHash();
 
 		}
 
@@ -192,6 +246,7 @@ namespace fart::types {
 			T reg = this->_get(index1);
 			this->_set(index1, this->_get(index2));
 			this->_set(index2, reg);
+			this->_invalidateHash();
 
 		}
 
@@ -199,17 +254,31 @@ namespace fart::types {
 
 			if (dstIndex > this->length()) throw OutOfBoundException(dstIndex);
 
-			this->_ensureStorageSize(this->length() + length);
-
-			for (size_t idx = this->length() ; idx > dstIndex ; idx--) {
-				this->_set(idx + length - 1, this->_get(idx - 1));
+			// Items from this data would move or be overwritten below.
+			if (items >= this->_pointer() && items < this->_pointer() + this->length()) {
+				Data<T> copy(items, length);
+				return this->insertItemsAtIndex(copy.items(), length, dstIndex);
 			}
 
-			for (size_t idx = 0 ; idx < length ; idx++) {
-				this->_set(idx + dstIndex, items[idx]);
+			bool appending = dstIndex == this->length();
+
+			this->_ensureStorageSize(this->length() + length);
+
+			if constexpr (is_trivially_copyable<T>::value) {
+				T* pointer = this->_pointer();
+				memmove(pointer + dstIndex + length, pointer + dstIndex, sizeof(T) * (this->length() - dstIndex));
+				if (length > 0) memcpy(pointer + dstIndex, items, sizeof(T) * length);
+			} else {
+				for (size_t idx = this->length() ; idx > dstIndex ; idx--) {
+					this->_set(idx + length - 1, this->_get(idx - 1));
+				}
+				for (size_t idx = 0 ; idx < length ; idx++) {
+					this->_set(idx + dstIndex, items[idx]);
+				}
 			}
 
 			this->_length += length;
+			this->_invalidateHash(appending);
 
 		}
 
@@ -218,7 +287,7 @@ namespace fart::types {
 		}
 
 		inline const T* items() const {
-			return *_storage + _offset;
+			return this->_pointer();
 		}
 
 		inline size_t length() const {
@@ -290,32 +359,21 @@ namespace fart::types {
 
 			if (other.length() + offset > this->length()) return false;
 
-			for (size_t idx = 0 ; idx < other.length() ; idx++) {
-				if (this->_get(offset + idx) != other._get(idx)) {
-					return false;
-				}
-			}
-
-			return true;
+			return Search::equal(this->items() + offset, other.items(), other.length());
 
 		}
 
-		size_t indexOf(const Data<T>& other, size_t offset = 0) const {
-			for (size_t index = offset ; index < this->length() ; index++) {
-				if (this->needle(other, index)) return index;
-			}
-			return NotFound;
+		inline size_t indexOf(const Data<T>& other, size_t offset = 0) const {
+			return this->_indexOf(other.items(), other.length(), offset);
 		}
 
 		inline size_t indexOf(T other, size_t offset = 0) const {
-			return indexOf(Data<T>(&other, 1), offset);
+			return this->_indexOf(&other, 1, offset);
 		}
 
 		size_t lastIndexOf(const Data<T>& other) const {
-			for (ssize_t index = this->length() - other.length(); index >= 0 ; index--) {
-				if (this->needle(other, (size_t)index)) return index;
-			}
-			return NotFound;
+			size_t index = Search::last(this->items(), this->length(), other.items(), other.length());
+			return index == Search::notFound ? NotFound : index;
 		}
 
 		inline bool contains(const Data<T>& other, size_t offset = 0) const {
@@ -342,6 +400,7 @@ namespace fart::types {
 			this->_ensureStorageOwnership();
 			T removed = this->_get(index);
 			this->_set(index, element);
+			this->_invalidateHash();
 			return removed;
 		}
 
@@ -380,17 +439,24 @@ namespace fart::types {
 
 			if (offset + length > this->length()) throw OutOfBoundException(offset + length);
 
-			this->_ensureStorageOwnership();
+			// Copied, as sharing storage would force a copy of all of it below.
+			Strong<Data<T>> result(this->items() + offset, length);
 
-			Strong<Data<T>> result = this->subdata(offset, length);
+			this->_ensureStorageOwnership();
 
 			size_t moveCount = this->length() - (offset + length);
 
-			for (size_t idx = 0 ; idx < moveCount ; idx++) {
-				this->_set(offset + idx, this->_get(offset + length + idx));
+			if constexpr (is_trivially_copyable<T>::value) {
+				T* pointer = this->_pointer();
+				memmove(pointer + offset, pointer + offset + length, sizeof(T) * moveCount);
+			} else {
+				for (size_t idx = 0 ; idx < moveCount ; idx++) {
+					this->_set(offset + idx, this->_get(offset + length + idx));
+				}
 			}
 
 			this->_length -= length;
+			this->_invalidateHash();
 
 			return result;
 
@@ -406,16 +472,15 @@ namespace fart::types {
 
 		void drain() {
 			Storage::release(&this->_storage);
-			_storage = new Storage();
 			_length = 0;
 			_offset = 0;
+			this->_invalidateHash();
 		};
 
 		size_t copy(void* bytes, size_t length, size_t offset = 0) {
 			if (offset > this->length()) return 0;
-			this->ensureStorageOwnership();
 			length = math::min(length, this->length() - offset);
-			memcpy(bytes, this->items(), sizeof(T) * length);
+			memcpy(bytes, this->items() + offset, sizeof(T) * length);
 			return length;
 		}
 
@@ -425,52 +490,46 @@ namespace fart::types {
 			});
 		}
 
-		Strong<Array<Data<T>>> split(const Array<Data<T>>& separators, IncludeSeparator includeSeparator = IncludeSeparator::none, size_t max = 0) const {
+		Strong<Array<Data<T>>> split(const Separators& separators, IncludeSeparator includeSeparator = IncludeSeparator::none, size_t max = 0) const {
 			Strong<Array<Data<T>>> result;
 			size_t idx = 0;
+			bool prefixed = includeSeparator == IncludeSeparator::prefix || includeSeparator == IncludeSeparator::both;
 			while (result->count() < max - 1) {
-				if (!separators.some([this,&idx,&result,&includeSeparator](const Data<T>& separator) {
-					size_t next = NotFound;
-					switch (includeSeparator) {
-						case IncludeSeparator::none:
-						case IncludeSeparator::suffix:
-							next = indexOf(separator, idx);
-							break;
-						case IncludeSeparator::prefix:
-						case IncludeSeparator::both:
-							next = indexOf(separator, idx + separator.length());
-							break;
-					}
-					if (next == NotFound) return false;
-					switch (includeSeparator) {
-						case IncludeSeparator::none:
-						case IncludeSeparator::prefix:
-							result->append(subdata(idx, next - idx));
-							break;
-						case IncludeSeparator::suffix:
-						case IncludeSeparator::both:
-							result->append(subdata(idx, next - idx + separator.length()));
-							break;
-					}
-					switch (includeSeparator) {
-						case IncludeSeparator::none:
-						case IncludeSeparator::suffix:
-							idx = next + separator.length();
-							break;
-						case IncludeSeparator::prefix:
-						case IncludeSeparator::both:
-							idx = next;
-							break;
-					}
-					return true;
-				})) break;
+				size_t separator;
+				size_t next = separators._find(*this, idx, prefixed, &separator);
+				if (next == NotFound) break;
+				size_t separatorLength = separators._length(separator);
+				switch (includeSeparator) {
+					case IncludeSeparator::none:
+					case IncludeSeparator::prefix:
+						result->append(subdata(idx, next - idx));
+						break;
+					case IncludeSeparator::suffix:
+					case IncludeSeparator::both:
+						result->append(subdata(idx, next - idx + separatorLength));
+						break;
+				}
+				switch (includeSeparator) {
+					case IncludeSeparator::none:
+					case IncludeSeparator::suffix:
+						idx = next + separatorLength;
+						break;
+					case IncludeSeparator::prefix:
+					case IncludeSeparator::both:
+						idx = next;
+						break;
+				}
 			}
 			result->append(subdata(idx, length() - idx));
 			return result;
 		}
 
+		inline Strong<Array<Data<T>>> split(const Array<Data<T>>& separators, IncludeSeparator includeSeparator = IncludeSeparator::none, size_t max = 0) const {
+			return split(Separators(separators), includeSeparator, max);
+		}
+
 		inline Strong<Array<Data<T>>> split(const Data<T>& separator, IncludeSeparator includeSeparator = IncludeSeparator::none, size_t max = 0) const {
-			return split(Array<Data<T>>(separator, 1), includeSeparator, max);
+			return split(Separators(separator), includeSeparator, max);
 		}
 
 		inline Strong<Array<Data<T>>> split(T* separator, size_t length, IncludeSeparator includeSeparator = IncludeSeparator::none, size_t max = 0) const {
@@ -495,7 +554,7 @@ namespace fart::types {
 
 		template<typename O>
 		inline Strong<Data<O>> as() const {
-			return Strong<Data<O>>((const O*)((T*)*this->_storage), (this->length() * sizeof(T)) / sizeof(O));
+			return Strong<Data<O>>((const O*)this->items(), (this->length() * sizeof(T)) / sizeof(O));
 		}
 
 		void forEach(function<void(T& item, size_t idx)> todo) const {
@@ -610,11 +669,25 @@ namespace fart::types {
 
 		virtual uint64_t hash() const override {
 			if (_hashIsDirty) {
-				Hashable::Builder builder;
-				for (size_t idx = 0 ; idx < this->length() ; idx++) {
-					builder.add(this->hashForItem(this->_get(idx)));
+				if constexpr (_hashesBytes) {
+					const uint8_t* bytes = (const uint8_t*)this->items();
+					size_t length = sizeof(T) * this->length();
+					if (length < Hashable::Stream::stripeSize * 2) {
+						_hash = Hashable::Stream().finish(bytes, length);
+					} else {
+						// Keep the stream, so appending only costs hashing the appended bytes.
+						if (_hashStream == nullptr) _hashStream = new Hashable::Stream();
+						size_t consumed = _hashStream->length();
+						consumed += _hashStream->update(bytes + consumed, length - consumed);
+						_hash = _hashStream->finish(bytes + consumed, length - consumed);
+					}
+				} else {
+					Hashable::Builder builder;
+					for (size_t idx = 0 ; idx < this->length() ; idx++) {
+						builder.add(this->hashForItem(this->_get(idx)));
+					}
+					_hash = builder;
 				}
-				_hash = builder;
 				_hashIsDirty = false;
 			}
 			return _hash;
@@ -626,10 +699,7 @@ namespace fart::types {
 
 		bool equals(const Data<T>& other) const {
 			if (this->length() != other.length()) return false;
-			for (size_t idx = 0 ; idx < this->length() ; idx++) {
-				if (this->_get(idx) != other._get(idx)) return false;
-			}
-			return true;
+			return Search::equal(this->items(), other.items(), this->length());
 		}
 
 		bool operator==(const Type& other) const override {
@@ -650,30 +720,38 @@ namespace fart::types {
 		}
 
 		Data& operator=(const Data<T>& other) {
+			if (this == &other) return *this;
 			Storage::release(&this->_storage);
-			this->_storage = other._storage->retain();
+			if (other._storage == nullptr) memcpy(this->_inline, other._inline, sizeof(T) * other._length);
+			else this->_storage = other._storage->retain();
 			this->_length = other._length;
 			this->_size = other._size;
 			this->_offset = other._offset;
 			this->_hashIsDirty = other._hashIsDirty;
 			this->_hash = other._hash;
+			if (this->_hashStream != nullptr) this->_hashStream->reset();
 			Type::operator=(other);
 			return *this;
 		}
 
 		Data& operator=(Data<T>&& other) {
+			if (this == &other) return *this;
 			Storage::release(&this->_storage);
+			if (other._storage == nullptr) memcpy(this->_inline, other._inline, sizeof(T) * other._length);
 			this->_storage = other._storage;
 			this->_length = other._length;
 			this->_size = other._size;
 			this->_offset = other._offset;
 			this->_hashIsDirty = other._hashIsDirty;
 			this->_hash = other._hash;
+			delete this->_hashStream;
+			this->_hashStream = other._hashStream;
 			other._storage = nullptr;
 			other._length = 0;
 			other._size = 0;
 			other._offset = 0;
 			other._hashIsDirty = true;
+			other._hashStream = nullptr;
 			Type::operator=(std::move(other));
 			return *this;
 		}
@@ -693,15 +771,18 @@ namespace fart::types {
 				this->ensureStorageSize(length);
 			}
 
+			// Takes over items, allocated by Allocator with room for capacity items.
+			Storage(T* items, size_t capacity) : _ptr(items), _length(capacity), _retainCount(1) {}
+
 			~Storage() {
 				if (this->_ptr != nullptr) {
-					free(this->_ptr);
+					Allocator::deallocate(this->_ptr);
 					this->_ptr = nullptr;
 				}
 			}
 
 			Storage* retain() const {
-				this->_retainCount++;
+				this->_retainCount.retain();
 				return (Storage*)this;
 			}
 
@@ -729,8 +810,9 @@ namespace fart::types {
 
 			void ensureStorageSize(size_t length) {
 				if (this->_length < length) {
+					size_t oldLength = this->_length;
 					this->_length = Allocator::calculateBufferLength(length);
-					this->_ptr = (T*) realloc(this->_ptr, sizeof(T) * this->_length);
+					this->_ptr = (T*)Allocator::reallocate(this->_ptr, sizeof(T) * oldLength, sizeof(T) * this->_length);
 				}
 			}
 
@@ -738,15 +820,17 @@ namespace fart::types {
 
 			Storage* own(size_t length, size_t offset, bool* replaced) const {
 				*replaced = false;
-				if (this->_retainCount == 1) return (Storage*)this;
+				if (this->_retainCount.isUnique()) return (Storage*)this;
+				// Copied before released, as another holder may be left the only one by the release,
+				// and mutate it in place.
+				Storage* result = new Storage(*this, offset, length);
 				this->release();
 				*replaced = true;
-				return new Storage(*this, offset, length);
+				return result;
 			}
 
 			Storage* release() const {
-				this->_retainCount--;
-				if (this->_retainCount == 0) {
+				if (this->_retainCount.release()) {
 					delete(this);
 				}
 				return nullptr;
@@ -754,47 +838,198 @@ namespace fart::types {
 
 			T* _ptr;
 			size_t _length;
-			mutable std::atomic<size_t> _retainCount;
+			mutable RetainCount _retainCount;
 
 			Storage(const Storage& other, size_t offset, size_t length) : Storage(length) {
-				for (size_t idx = 0 ; idx < length ; idx++) {
-					this->_ptr[idx] = other._ptr[idx + offset];
+				if constexpr (is_trivially_copyable<T>::value) {
+					if (length > 0) memcpy(this->_ptr, other._ptr + offset, sizeof(T) * length);
+				} else {
+					for (size_t idx = 0 ; idx < length ; idx++) {
+						this->_ptr[idx] = other._ptr[idx + offset];
+					}
 				}
 			}
 
 		};
 
+		// Short data of trivially copyable items is kept inline, in which case there is no storage.
+		static constexpr size_t _inlineCapacity = is_trivially_copyable<T>::value ? FART_DATA_INLINE_SIZE / sizeof(T) : 0;
+
 		Storage* _storage;
 		size_t _offset;
 		size_t _length;
 		size_t _size;
 		mutable bool _hashIsDirty;
 		mutable uint64_t _hash;
+		// State of the hash of the bytes hashed so far - only kept for longer data.
+		mutable Hashable::Stream* _hashStream;
+
+		// Integers (and pointers) are equal exactly when their bytes are, so their bytes are hashed.
+		static constexpr bool _hashesBytes = is_integral<T>::value || is_pointer<T>::value;
+		// Aligned for at least 32 bit items, so byte data may be viewed as wider units (see String).
+		alignas(MAX(alignof(T), alignof(uint32_t))) uint8_t _inline[MAX(_inlineCapacity * sizeof(T), 1)];
 
 		void _ensureStorageSize(size_t length) {
-			if (this->_storage == nullptr) this->_storage = new Storage(length);
-			else {
+			if (this->_storage == nullptr) {
+				if (length <= _inlineCapacity) return;
+				Storage* storage = new Storage(length);
+				if (this->_length > 0) memcpy((T*)*storage, this->_inline, sizeof(T) * this->_length);
+				this->_storage = storage;
+			} else {
 				this->_ensureStorageOwnership();
-				this->_storage->ensureStorageSize(length);
+				this->_storage->ensureStorageSize(this->_offset + length);
 			}
 		}
 
+		// Only appending keeps the hashed bytes valid.
+		inline void _invalidateHash(bool appended = false) {
+			this->_hashIsDirty = true;
+			if (!appended && this->_hashStream != nullptr) this->_hashStream->reset();
+		}
+
 		inline void _ensureStorageOwnership() {
 			if (Storage::own(&this->_storage, this->_length, this->_offset)) {
 				this->_offset = 0;
 			}
 		}
 
-		inline size_t _index(size_t index) const {
-			return this->_offset + index;
+		size_t _indexOf(const T* items, size_t length, size_t offset) const {
+			if (offset >= this->length()) return NotFound;
+			size_t index = Search::first(this->items() + offset, this->length() - offset, items, length);
+			return index == Search::notFound ? NotFound : offset + index;
+		}
+
+		// Takes over items (see Storage), instead of copying them.
+		static Data<T> _adopting(T* items, size_t length, size_t capacity) {
+			Data<T> result;
+			if (items == nullptr) return result;
+			result._storage = new Storage(items, capacity);
+			result._length = length;
+			return result;
+		}
+
+		inline T* _pointer() const {
+			if (this->_storage == nullptr) return (T*)this->_inline;
+			return *this->_storage + this->_offset;
 		}
 
 		inline T& _get(size_t index) const {
-			return this->_storage->get(this->_index(index));
+			return this->_pointer()[index];
 		}
 
 		inline T& _set(size_t index, const T& value) {
-			return this->_storage->set(this->_index(index), value);
+			return this->_pointer()[index] = value;
+		}
+
+	};
+
+	// A compiled set of separators for split(). Splitting finds the earliest occurrence of any
+	// of them in one pass (the first listed wins when several start at the same index). Keep
+	// and reuse them when splitting repeatedly by the same separators.
+	template<typename T>
+	class Data<T>::Separators : public Object {
+
+		friend class Data<T>;
+
+	public:
+
+		Separators(const Array<Data<T>>& separators) : Separators() {
+			separators.forEach([this](const Data<T>& separator) {
+				this->_add(separator);
+			});
+		}
+
+		Separators(const Data<T>& separator) : Separators() {
+			this->_add(separator);
+		}
+
+		inline size_t count() const {
+			return this->_offsets.length() - 1;
+		}
+
+	private:
+
+		// All separators, one after the other.
+		Data<T> _items;
+		Data<size_t> _offsets;
+		Search::Set _firsts;
+		size_t _minimumLength;
+		// Separators by the low byte of their first item, chained in the order they are listed.
+		size_t _heads[256];
+		Data<size_t> _chain;
+
+		Separators() : _minimumLength(math::limit<size_t>()) {
+			this->_offsets.append(0);
+			for (size_t idx = 0 ; idx < 256 ; idx++) {
+				this->_heads[idx] = NotFound;
+			}
+		}
+
+		void _add(const Data<T>& separator) {
+
+			// Empty separators would match everywhere.
+			if (separator.length() == 0) return;
+
+			size_t index = this->count();
+			uint8_t first = (uint8_t)separator.items()[0];
+
+			this->_items.append(separator);
+			this->_offsets.append(this->_items.length());
+			this->_firsts.add(first);
+			this->_minimumLength = math::min(this->_minimumLength, separator.length());
+
+			this->_chain.append(NotFound);
+			if (this->_heads[first] == NotFound) this->_heads[first] = index;
+			else {
+				size_t last = this->_heads[first];
+				while (this->_chain.items()[last] != NotFound) last = this->_chain.items()[last];
+				this->_chain.replace(index, last);
+			}
+
+		}
+
+		inline const T* _separator(size_t index) const {
+			return this->_items.items() + this->_offsets.items()[index];
+		}
+
+		inline size_t _length(size_t index) const {
+			return this->_offsets.items()[index + 1] - this->_offsets.items()[index];
+		}
+
+		// Separators must start at or after idx - or their own length after it, if prefixed.
+		size_t _find(const Data<T>& data, size_t idx, bool prefixed, size_t* separator) const {
+
+			if (this->count() == 0) return NotFound;
+
+			if (this->count() == 1) {
+				*separator = 0;
+				return data._indexOf(this->_separator(0), this->_length(0), idx + (prefixed ? this->_length(0) : 0));
+			}
+
+			const T* items = data.items();
+			size_t length = data.length();
+
+			for (size_t position = idx + (prefixed ? this->_minimumLength : 0) ; position < length ; position++) {
+
+				size_t found = Search::firstOf(items + position, length - position, this->_firsts);
+
+				if (found == Search::notFound) break;
+
+				position += found;
+
+				for (size_t index = this->_heads[(uint8_t)items[position]] ; index != NotFound ; index = this->_chain.items()[index]) {
+					size_t separatorLength = this->_length(index);
+					if (prefixed && position < idx + separatorLength) continue;
+					if (separatorLength > length - position) continue;
+					if (!Search::equal(items + position, this->_separator(index), separatorLength)) continue;
+					*separator = index;
+					return position;
+				}
+
+			}
+
+			return NotFound;
+
 		}
 
 	};
@@ -298,17 +298,17 @@ namespace fart::types {
 		}
 
 		String toISO8601() const {
-			String ret;
-			ret.append(String::format("%02lld-%02d-%02dT%02d:%02d:%02d",
-									  this->year(),
-									  this->month(),
-									  this->day(),
-									  this->hours(),
-									  this->minutes(),
-									  this->seconds()));
+			String::Builder ret(32);
+			ret.format("{:02}-{:02}-{:02}T{:02}:{:02}:{:02}",
+					   this->year(),
+					   this->month(),
+					   this->day(),
+					   this->hours(),
+					   this->minutes(),
+					   this->seconds());
 			auto microseconds = this->microseconds();
 			if (microseconds != 0) {
-				ret.append(String::format(".%llu", microseconds));
+				ret.format(".{}", microseconds);
 			}
 			switch (this->_timeZone) {
 				case TimeZone::utc:
@@ -319,7 +319,7 @@ namespace fart::types {
 					break;
 				}
 			}
-			return ret;
+			return ret.string();
 		}
 
 		virtual Kind kind() const override {
@@ -11,12 +11,28 @@
 
 #include <thread>
 #include "./array.hpp"
+#include "./data.hpp"
 #include "./pair.hpp"
 #include "./type.hpp"
 
 namespace fart::types {
 
-	template<typename Key, class Value = Type>
+	// How a dictionary hashes and compares its keys - by their own hash and equality. Another
+	// policy with the same two functions can be given instead, as String::CaseInsensitive.
+	template<typename Key>
+	struct KeyPolicy {
+
+		static inline uint64_t hash(const Key& key) {
+			return key.hash();
+		}
+
+		static inline bool equals(const Key& key, const Key& other) {
+			return key == other;
+		}
+
+	};
+
+	template<typename Key, class Value = Type, class Policy = KeyPolicy<Key>>
 	class Dictionary : public Type {
 
 		static_assert(std::is_base_of<Object, Key>::value);
@@ -24,8 +40,132 @@ namespace fart::types {
 		static_assert(std::is_base_of<Object, Value>::value);
 
 	private:
-		Array<Key> _keys;
-		Array<Value> _values;
+		// Entries in insertion order, retained. Removed entries are left as null until more than
+		// half of the entries are removed, and then the entries are compacted - so entries keep
+		// their index, and removal does not move the others.
+		Data<Key*> _keys;
+		Data<Value*> _values;
+		size_t _count;
+
+		// Open addressing index into _keys/_values. Slots hold entry index + 1 (zero is empty),
+		// and _hashes caches the hash of each entry, so probing rarely needs to compare keys.
+		Data<uint64_t> _hashes;
+		Data<size_t> _slots;
+
+		inline static uint64_t _mix(uint64_t hash) {
+			hash ^= hash >> 33;
+			hash *= 0xFF51AFD7ED558CCDULL;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		size_t _findSlot(const Key& key, uint64_t hash) const {
+			if (_slots.length() == 0) return NotFound;
+			const size_t* slots = _slots.items();
+			const uint64_t* hashes = _hashes.items();
+			Key* const* keys = _keys.items();
+			size_t mask = _slots.length() - 1;
+			for (size_t slot = _mix(hash) & mask ; slots[slot] != 0 ; slot = (slot + 1) & mask) {
+				size_t index = slots[slot] - 1;
+				if (hashes[index] == hash && Policy::equals(*keys[index], key)) return slot;
+			}
+			return NotFound;
+		}
+
+		inline size_t _find(const Key& key, uint64_t hash) const {
+			size_t slot = _findSlot(key, hash);
+			return slot != NotFound ? _slots.items()[slot] - 1 : NotFound;
+		}
+
+		void _insertSlot(size_t index, uint64_t hash) {
+			const size_t* slots = _slots.items();
+			size_t mask = _slots.length() - 1;
+			size_t slot = _mix(hash) & mask;
+			while (slots[slot] != 0) slot = (slot + 1) & mask;
+			_slots.replace(index + 1, slot);
+		}
+
+		// Empties slot, and moves the slots after it back, as far as they can go towards where
+		// their hash puts them - so no probe sequence has a gap.
+		void _removeSlot(size_t slot) {
+			const size_t* slots = _slots.items();
+			const uint64_t* hashes = _hashes.items();
+			size_t mask = _slots.length() - 1;
+			for (size_t next = (slot + 1) & mask ; slots[next] != 0 ; next = (next + 1) & mask) {
+				size_t home = _mix(hashes[slots[next] - 1]) & mask;
+				if (((next - home) & mask) < ((next - slot) & mask)) continue;
+				_slots.replace(slots[next], slot);
+				slots = _slots.items();
+				slot = next;
+			}
+			_slots.replace(0, slot);
+		}
+
+		void _reindex(size_t capacity) {
+			_slots = Data<size_t>(capacity, 0);
+			const uint64_t* hashes = _hashes.items();
+			Key* const* keys = _keys.items();
+			for (size_t idx = 0 ; idx < _keys.length() ; idx++) {
+				if (keys[idx] != nullptr) _insertSlot(idx, hashes[idx]);
+			}
+		}
+
+		// Drops removed entries, and indexes the rest where they are then.
+		void _compact() {
+			Data<Key*> keys(_count);
+			Data<Value*> values(_count);
+			Data<uint64_t> hashes(_count);
+			for (size_t idx = 0 ; idx < _keys.length() ; idx++) {
+				if (_keys.items()[idx] == nullptr) continue;
+				keys.append(_keys.items()[idx]);
+				values.append(_values.items()[idx]);
+				hashes.append(_hashes.items()[idx]);
+			}
+			_keys = std::move(keys);
+			_values = std::move(values);
+			_hashes = std::move(hashes);
+			_reindex(_slots.length());
+		}
+
+		void _append(Strong<Key> key, Strong<Value> value, uint64_t hash) {
+			// Keep the load factor below 3/4.
+			if ((_count + 1) * 4 > _slots.length() * 3) {
+				_reindex(math::max<size_t>(_slots.length() * 2, 8));
+			}
+			key->retain();
+			value->retain();
+			_keys.append(key);
+			_values.append(value);
+			_hashes.append(hash);
+			_count++;
+			_insertSlot(_keys.length() - 1, hash);
+		}
+
+		void _retainAll() const {
+			for (size_t idx = 0 ; idx < _keys.length() ; idx++) {
+				if (_keys.items()[idx] == nullptr) continue;
+				_keys.items()[idx]->retain();
+				_values.items()[idx]->retain();
+			}
+		}
+
+		void _releaseAll() {
+			for (size_t idx = 0 ; idx < _keys.length() ; idx++) {
+				if (_keys.items()[idx] == nullptr) continue;
+				_keys.items()[idx]->release();
+				_values.items()[idx]->release();
+			}
+		}
+
+		// Calls todo with the key and value of each entry, in order, with its position among them.
+		template<typename Func>
+		void _each(Func todo) const {
+			size_t position = 0;
+			for (size_t idx = 0 ; idx < _keys.length() ; idx++) {
+				if (_keys.items()[idx] == nullptr) continue;
+				todo(*_keys.items()[idx], *_values.items()[idx], position++);
+			}
+		}
 
 	public:
 
@@ -33,43 +173,51 @@ namespace fart::types {
 			return Type::Kind::dictionary;
 		}
 
-		Dictionary() : Type(), _keys(), _values() {}
-		Dictionary(const Dictionary<Key,Value>& other) : Type(), _keys(other._keys), _values(other._values) {}
-		Dictionary(Dictionary<Key,Value>&& other) : Type(), _keys(std::move(other._keys)), _values(std::move(other._values)) {}
+		Dictionary() : Type(), _keys(), _values(), _count(0), _hashes(), _slots() {}
 
-		Dictionary(const Pair<Key, Value>& keyValue) : Type(), _keys({ keyValue.first }), _values({ keyValue.second }) {}
+		Dictionary(const Dictionary<Key, Value, Policy>& other) : Type(), _keys(other._keys), _values(other._values), _count(other._count), _hashes(other._hashes), _slots(other._slots) {
+			this->_retainAll();
+		}
 
-		Dictionary(const Array<Pair<Key, Value>>& keyValues) : Type(), _keys(), _values() {
-			_keys = keyValues.template map<Key>([](const Pair<Key, Value>& keyValue) {
-				return Strong<Key>(keyValue.first());
-			});
-			_values = keyValues.template map<Value>([](const Pair<Key, Value>& keyValue) {
-				return Strong<Value>(keyValue.second());
+		Dictionary(Dictionary<Key, Value, Policy>&& other) : Type(), _keys(std::move(other._keys)), _values(std::move(other._values)), _count(other._count), _hashes(std::move(other._hashes)), _slots(std::move(other._slots)) {
+			other._count = 0;
+		}
+
+		Dictionary(const Pair<Key, Value>& keyValue) : Dictionary() {
+			set(keyValue.first(), keyValue.second());
+		}
+
+		Dictionary(const Array<Pair<Key, Value>>& keyValues) : Dictionary() {
+			keyValues.forEach([this](const Pair<Key, Value>& keyValue) {
+				set(keyValue.first(), keyValue.second());
 			});
 		}
 
-		Dictionary(std::initializer_list<std::pair<Key&, Value&>> keyValues) : Type(), _keys(), _values() {
+		Dictionary(std::initializer_list<std::pair<Key&, Value&>> keyValues) : Dictionary() {
 			for (auto keyValue : keyValues) {
-				_keys.append(keyValue.first);
-				_values.append(keyValue.second);
+				set(keyValue.first, keyValue.second);
 			}
 		}
 
-		virtual ~Dictionary() {}
+		virtual ~Dictionary() {
+			this->_releaseAll();
+		}
 
 		void set(Strong<Key> key, Strong<Value> value) {
-			size_t index = _keys.indexOf(key);
+			uint64_t hash = Policy::hash(key);
+			size_t index = _find(key, hash);
 			if (index != NotFound) {
-				_keys.replace(key, index);
-				_values.replace(value, index);
+				key->retain();
+				value->retain();
+				_keys.replace(key, index)->release();
+				_values.replace(value, index)->release();
 			} else {
-				_keys.append(key);
-				_values.append(value);
+				_append(key, value, hash);
 			}
 		}
 
-		Strong<Dictionary<Key, Value>> setting(Strong<Key> key, Strong<Value> value) {
-			Strong<Dictionary<Key, Value>> result;
+		Strong<Dictionary<Key, Value, Policy>> setting(Strong<Key> key, Strong<Value> value) {
+			Strong<Dictionary<Key, Value, Policy>> result;
 			result = result->setting(*this);
 			result->set(key, value);
 			return result;
@@ -79,46 +227,58 @@ namespace fart::types {
 			set(keyValue.first, keyValue.second);
 		}
 
-		void set(const Dictionary<Key, Value>& dictionary) {
+		void set(const Dictionary<Key, Value, Policy>& dictionary) {
 			dictionary.iterate()->forEach([&](const Pair<Key, Value>& element) {
 				set(element.first(), element.second());
 			});
 		}
 
-		Strong<Dictionary<Key, Value>> setting(const Dictionary<Key, Value>& dictionary) const {
-			Strong<Dictionary<Key, Value>> result;
+		Strong<Dictionary<Key, Value, Policy>> setting(const Dictionary<Key, Value, Policy>& dictionary) const {
+			Strong<Dictionary<Key, Value, Policy>> result;
 			result->set(*this);
 			result->set(dictionary);
 			return result;
 		}
 
 		void remove(Strong<Key> key) {
-			size_t index = _keys.indexOf(key);
-			if (index == NotFound) {
+			size_t slot = _findSlot(key, Policy::hash(key));
+			if (slot == NotFound) {
 				throw KeyNotFoundException();
 			}
-			_keys.removeItemAtIndex(index);
-			_values.removeItemAtIndex(index);
-		}
-
-		inline Strong<Array<Key>> keys() const {
-			return Strong<Array<Key>>(_keys);
+			size_t index = _slots.items()[slot] - 1;
+			_removeSlot(slot);
+			_keys.replace(nullptr, index)->release();
+			_values.replace(nullptr, index)->release();
+			_count--;
+			if (_count * 2 < _keys.length()) _compact();
+		}
+
+		Strong<Array<Key>> keys() const {
+			Strong<Array<Key>> result;
+			this->_each([&](Key& key, Value&, size_t) {
+				result->append(key);
+			});
+			return result;
 		}
 
-		inline Strong<Array<Value>> values() const {
-			return Strong<Array<Value>>(_values);
+		Strong<Array<Value>> values() const {
+			Strong<Array<Value>> result;
+			this->_each([&](Key&, Value& value, size_t) {
+				result->append(value);
+			});
+			return result;
 		}
 
 		inline bool hasKey(const Key& key) const {
-			return _keys.indexOf(key) != NotFound;
+			return _find(key, Policy::hash(key)) != NotFound;
 		}
 
 		Strong<Value> get(const Key& key) const noexcept(false) {
-			size_t keyIndex = _keys.indexOf(key);
+			size_t keyIndex = _find(key, Policy::hash(key));
 			if (keyIndex == NotFound) {
 				throw KeyNotFoundException();
 			}
-			return _values[keyIndex];
+			return *_values.items()[keyIndex];
 		}
 
 		Strong<Value> get(const Key& key, const Value& defaultValue) const {
@@ -137,7 +297,7 @@ namespace fart::types {
 		}
 
 		inline size_t count() const {
-			return _keys.count();
+			return _count;
 		}
 
 		Strong<Array<Pair<Key, Value>>> keyValues() const {
@@ -147,9 +307,9 @@ namespace fart::types {
 		}
 
 		void forEach(const function<void(const Pair<Key, Value>&)>& todo) const {
-			for (size_t idx = 0 ; idx < _keys.count() ; idx++) {
-				todo(Pair<Key, Value>(_keys[idx], _values[idx]));
-			}
+			this->_each([&](Key& key, Value& value, size_t) {
+				todo(Pair<Key, Value>(key, value));
+			});
 		}
 
 		template<typename OtherValue>
@@ -164,21 +324,18 @@ namespace fart::types {
 			});
 		}
 
-		Strong<Dictionary<Key, Value>> filter(const function<bool(const Pair<Key, Value>&)>& todo) const {
-			Strong<Dictionary<Key, Value>> result;
-			for (size_t idx = 0 ; idx < this->_keys.count() ; idx++) {
-				Strong<Key> key = this->_keys[idx];
-				Strong<Value> value = this->_values[idx];
+		Strong<Dictionary<Key, Value, Policy>> filter(const function<bool(const Pair<Key, Value>&)>& todo) const {
+			Strong<Dictionary<Key, Value, Policy>> result;
+			this->_each([&](Key& key, Value& value, size_t) {
 				if (todo(Pair<Key, Value>(key, value))) result->set(key, value);
-			}
+			});
 			return result;
 		}
 
 		template<typename OtherKey>
 		Strong<Dictionary<OtherKey, Value>> mapKeys(const function<Strong<OtherKey>(const Pair<Key, Value>&, size_t)>& todo) const {
 			Strong<Dictionary<OtherKey, Value>> result;
-			this->_keys.forEach([&todo,&result,this](Key& key, size_t idx) {
-				Strong<Value> value = this->get(key);
+			this->_each([&](Key& key, Value& value, size_t idx) {
 				result->set(todo(Strong<Pair<Key, Value>>(key, value), idx), value);
 			});
 			return result;
@@ -192,17 +349,16 @@ namespace fart::types {
 		}
 
 		template<typename OtherValue>
-		Strong<Dictionary<Key, OtherValue>> mapValues(const function<Strong<OtherValue>(const Pair<Key, Value>&, size_t)>& todo) const {
-			Strong<Dictionary<Key, OtherValue>> result;
-			this->_keys.forEach([&todo,&result,this](Key& key, size_t idx) {
-				Strong<Value> value = this->get(key);
+		Strong<Dictionary<Key, OtherValue, Policy>> mapValues(const function<Strong<OtherValue>(const Pair<Key, Value>&, size_t)>& todo) const {
+			Strong<Dictionary<Key, OtherValue, Policy>> result;
+			this->_each([&](Key& key, Value& value, size_t idx) {
 				result->set(key, todo(Strong<Pair<Key, Value>>(key, value), idx));
 			});
 			return result;
 		}
 
 		template<typename OtherValue>
-		Strong<Dictionary<Key, OtherValue>> mapValues(const function<Strong<OtherValue>(const Pair<Key, Value>&)>& todo) const {
+		Strong<Dictionary<Key, OtherValue, Policy>> mapValues(const function<Strong<OtherValue>(const Pair<Key, Value>&)>& todo) const {
 			return this->mapValues<OtherValue>([&todo](const Pair<Key, Value>& pair, size_t) {
 				return todo(pair);
 			});
@@ -219,15 +375,17 @@ namespace fart::types {
 		}
 
 		Strong<Array<Pair<Key, Value>>> iterate() const {
-			return this->_keys.template map<Pair<Key, Value>>([&](Strong<Key> key, size_t idx) {
-				return Strong<Pair<Key, Value>>(key, this->_values[idx]);
+			Strong<Array<Pair<Key, Value>>> result;
+			this->_each([&](Key& key, Value& value, size_t) {
+				result->append(Strong<Pair<Key, Value>>(key, value));
 			});
+			return result;
 		}
 
 		virtual uint64_t hash() const override {
 			auto builder = Builder();
-			this->_keys.forEach([&](const Key& key) {
-				builder.add(key);
+			this->_each([&](Key& key, Value&, size_t) {
+				builder.add(Policy::hash(key));
 			});
 			return builder;
 		}
@@ -240,40 +398,51 @@ namespace fart::types {
 
 			if (!other.is(Type::Kind::dictionary)) return false;
 
-			const Dictionary<Key, Value>& otherDictionary = (const Dictionary<Key, Value>&)other;
+			const Dictionary<Key, Value, Policy>& otherDictionary = (const Dictionary<Key, Value, Policy>&)other;
 
-			if (_keys.count() != otherDictionary._keys.count()) return false;
+			if (_count != otherDictionary._count) return false;
 
-			if (_keys.some([&](const Key& key) {
-				return !otherDictionary._keys.contains(key);
-			})) return false;
+			bool result = true;
 
-			if constexpr (std::is_base_of<Hashable, Value>::value) {
-				return _keys.every([&](const Key& key) {
-					return this->get(key) == otherDictionary.get(key);
-				});
-			} else {
-				return true;
-			}
+			this->_each([&](Key& key, Value& value, size_t) {
+				if (!result) return;
+				size_t index = otherDictionary._find(key, Policy::hash(key));
+				if (index == NotFound) result = false;
+				else if constexpr (std::is_base_of<Hashable, Value>::value) {
+					result = value == *otherDictionary._values.items()[index];
+				}
+			});
+
+			return result;
 
 		}
 
 		virtual bool operator!=(const Type& other) const override {
 			if (!other.is(Type::Kind::dictionary)) return true;
-			return this->operator!=((const Dictionary<Key, Value>&)other);
+			return this->operator!=((const Dictionary<Key, Value, Policy>&)other);
 		}
 
-		Dictionary<Key, Value>& operator=(const Dictionary<Key, Value>& other) {
+		Dictionary<Key, Value, Policy>& operator=(const Dictionary<Key, Value, Policy>& other) {
 			Type::operator=(other);
+			other._retainAll();
+			this->_releaseAll();
 			_keys = other._keys;
 			_values = other._values;
+			_count = other._count;
+			_hashes = other._hashes;
+			_slots = other._slots;
 			return *this;
 		}
 
-		Dictionary<Key, Value>& operator=(Dictionary<Key, Value>&& other) {
+		Dictionary<Key, Value, Policy>& operator=(Dictionary<Key, Value, Policy>&& other) {
 			Type::operator=(std::move(other));
+			this->_releaseAll();
+			_count = other._count;
+			other._count = 0;
 			_keys = std::move(other._keys);
 			_values = std::move(other._values);
+			_hashes = std::move(other._hashes);
+			_slots = std::move(other._slots);
 			return *this;
 		}
 
@@ -164,10 +164,8 @@ namespace fart::types {
 			double absOffset = fabs(offset);
 			uint64_t hours = Duration(absOffset).hours();
 			uint64_t minutes = Duration(absOffset - Duration::fromHours(hours)).minutes();
-			String prefix = offset < 0 ? "-" : (static_cast<uint8_t>(options) & static_cast<uint8_t>(ToStringOptions::prefixPositive) ? "+" : "");
-			return prefix.mapCString<String>([&hours,&minutes](const char* prefix){
-				return String(String::format("%s%02llu:%02llu", prefix, hours, minutes));
-			});
+			const char* prefix = offset < 0 ? "-" : (static_cast<uint8_t>(options) & static_cast<uint8_t>(ToStringOptions::prefixPositive) ? "+" : "");
+			return String::Builder(6).format("{}{:02}:{:02}", prefix, hours, minutes).string();
 		}
 
 		operator double() const {
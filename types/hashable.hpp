@@ -9,6 +9,9 @@
 #ifndef hashable_hpp
 #define hashable_hpp
 
+#include <stdint.h>
+#include <string.h>
+
 #include "../exceptions/exception.hpp"
 #include "../tools/math.hpp"
 
@@ -56,6 +59,126 @@ namespace fart::types {
 
 			};
 
+			// Streaming 64-bit hash of raw bytes (XXH64, seed zero). Whole stripes can be consumed
+			// as data arrives, and finish() hashes whatever is left without changing the state.
+			class Stream {
+
+			public:
+
+				static constexpr size_t stripeSize = 32;
+
+				Stream() {
+					this->reset();
+				}
+
+				void reset() {
+					_lanes[0] = _prime1 + _prime2;
+					_lanes[1] = _prime2;
+					_lanes[2] = 0;
+					_lanes[3] = -_prime1;
+					_length = 0;
+				}
+
+				// Number of bytes consumed so far.
+				inline uint64_t length() const {
+					return _length;
+				}
+
+				// Consumes all whole stripes, and returns the number of bytes consumed.
+				size_t update(const uint8_t* bytes, size_t length) {
+					size_t consumed = _consume(_lanes, bytes, length);
+					_length += consumed;
+					return consumed;
+				}
+
+				uint64_t finish(const uint8_t* bytes, size_t length) const {
+
+					uint64_t lanes[4] = { _lanes[0], _lanes[1], _lanes[2], _lanes[3] };
+					size_t consumed = _consume(lanes, bytes, length);
+					uint64_t total = _length + length;
+
+					bytes += consumed;
+					length -= consumed;
+
+					uint64_t hash;
+
+					if (total >= stripeSize) {
+						hash = _rotate(lanes[0], 1) + _rotate(lanes[1], 7) + _rotate(lanes[2], 12) + _rotate(lanes[3], 18);
+						for (size_t idx = 0 ; idx < 4 ; idx++) {
+							hash = (hash ^ _round(0, lanes[idx])) * _prime1 + _prime4;
+						}
+					} else {
+						hash = _prime5;
+					}
+
+					hash += total;
+
+					for ( ; length >= 8 ; bytes += 8, length -= 8) {
+						hash ^= _round(0, _read<uint64_t>(bytes));
+						hash = _rotate(hash, 27) * _prime1 + _prime4;
+					}
+
+					if (length >= 4) {
+						hash ^= (uint64_t)_read<uint32_t>(bytes) * _prime1;
+						hash = _rotate(hash, 23) * _prime2 + _prime3;
+						bytes += 4;
+						length -= 4;
+					}
+
+					for ( ; length > 0 ; bytes++, length--) {
+						hash ^= *bytes * _prime5;
+						hash = _rotate(hash, 11) * _prime1;
+					}
+
+					hash ^= hash >> 33;
+					hash *= _prime2;
+					hash ^= hash >> 29;
+					hash *= _prime3;
+					hash ^= hash >> 32;
+
+					return hash;
+
+				}
+
+			private:
+
+				static constexpr uint64_t _prime1 = 0x9E3779B185EBCA87ULL;
+				static constexpr uint64_t _prime2 = 0xC2B2AE3D27D4EB4FULL;
+				static constexpr uint64_t _prime3 = 0x165667B19E3779F9ULL;
+				static constexpr uint64_t _prime4 = 0x85EBCA77C2B2AE63ULL;
+				static constexpr uint64_t _prime5 = 0x27D4EB2F165667C5ULL;
+
+				uint64_t _lanes[4];
+				uint64_t _length;
+
+				inline static uint64_t _rotate(uint64_t value, int bits) {
+					return (value << bits) | (value >> (64 - bits));
+				}
+
+				inline static uint64_t _round(uint64_t lane, uint64_t input) {
+					return _rotate(lane + input * _prime2, 31) * _prime1;
+				}
+
+				template<typename T>
+				inline static T _read(const uint8_t* bytes) {
+					T value;
+					memcpy(&value, bytes, sizeof(T));
+					return value;
+				}
+
+				// The four lanes are independent, so this vectorizes or pipelines well.
+				static size_t _consume(uint64_t* lanes, const uint8_t* bytes, size_t length) {
+					size_t consumed = 0;
+					for ( ; consumed + stripeSize <= length ; consumed += stripeSize) {
+						for (size_t idx = 0 ; idx < 4 ; idx++) {
+							lanes[idx] = _round(lanes[idx], _read<uint64_t>(bytes + consumed + idx * 8));
+						}
+					}
+					return consumed;
+				}
+
+			};
+
 			Hashable() { }
 
 			Hashable(const Hashable&) { }
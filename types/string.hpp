@@ -12,18 +12,32 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <math.h>
+#include <atomic>
+#include <type_traits>
 
 #include "../system/endian.hpp"
 #include "../memory/strong.hpp"
 #include "../exceptions/exception.hpp"
+#include "../tools/search.hpp"
+#include "../tools/transcoder.hpp"
+#include "../tools/floating-point.hpp"
 #include "./data.hpp"
 #include "./type.hpp"
 #include "./array.hpp"
 #include "./unicode.hpp"
 
+#ifndef FART_STRING_BUILDER_ROPE_LENGTH
+#define FART_STRING_BUILDER_ROPE_LENGTH 4096
+#endif
+
 using namespace fart::system;
 using namespace fart::memory;
 using namespace fart::exceptions;
+using namespace fart::tools;
+
+namespace fart::serialization {
+	class JSONWriter;
+}
 
 namespace fart::types {
 
@@ -33,28 +47,39 @@ namespace fart::types {
 	static const Data<uint8_t> bigEndianBOM(_bigEndianBOM, 2);
 	static const Data<uint8_t> littleEndianBOM(_littleEndianBOM, 2);
 
+	// Code points are stored in the narrowest width able to hold all of them - one byte
+	// (Latin-1), two bytes (BMP) or four bytes - so ASCII heavy strings take up their UTF-8
+	// size, and equal strings always have equal storage.
 	class String : public Type, public Comparable<String> {
 
+		friend class Atoms;
+		friend class fart::serialization::JSONWriter;
+
 	public:
 
 		static Type::Kind typeKind() {
 			return Type::Kind::string;
 		}
 
-		String() : String(Data<uint32_t>()) {}
+		String() : _storage(), _width(1), _atom(false), _cString(nullptr) {}
 
 		String(const char* string) noexcept(false) : String() {
 			if (string != nullptr) {
-				_storage.append(_decodeUTF8((const uint8_t*)string, strlen(string)));
+				_decodeUTF8((const uint8_t*)string, strlen(string));
 			}
 		}
 
 		String(const Data<uint8_t>& data) noexcept(false) : String() {
-			_storage.append(_decodeUTF8(data.items(), _lengthWithoutNullTerminator<uint8_t>(data)));
+			_decodeUTF8(data.items(), _lengthWithoutNullTerminator<uint8_t>(data), &data);
+		}
+
+		// Decodes length bytes of UTF-8 as they are - a byte order mark is kept as a character.
+		String(const uint8_t* bytes, size_t length) noexcept(false) : String() {
+			_decodeUTF8(bytes, length, nullptr, false);
 		}
 
 		String(const Data<uint16_t>& data, const Endian::Variant& endian) noexcept(false) : String() {
-			_storage.append(_decodeUTF16(data.items(), _lengthWithoutNullTerminator<uint16_t>(data), endian));
+			_decodeUTF16(data.items(), _lengthWithoutNullTerminator<uint16_t>(data), endian);
 		}
 
 		String(const Data<uint16_t>& data) noexcept(false) : String() {
@@ -67,16 +92,22 @@ namespace fart::types {
 					parseData = parseData->subdata(2);
 				}
 			}
-			_storage.append(_decodeUTF16(parseData->items(), parseData->length(), endian));
+			_decodeUTF16(parseData->items(), parseData->length(), endian);
 		}
 
-		String(const Data<uint32_t>& store) : _storage(store) {}
+		String(const Data<uint32_t>& store) : String() {
+			_appendUnits(store.items(), store.length());
+		}
 
-		String(const uint32_t character) : _storage(&character, 1) {}
+		String(const uint32_t character) : String() {
+			_appendUnits(&character, 1);
+		}
 
-		String(const String& other) : String(other._storage) {}
+		String(const String& other) : _storage(other._storage), _width(other._width), _atom(false), _cString(other._retainedCString()) {}
 
-		String(String&& other) : _storage(std::move(other._storage)) { }
+		String(String&& other) : _storage(std::move(other._storage)), _width(other._width), _atom(false), _cString(other._cString.exchange(nullptr)) {
+			other._width = 1;
+		}
 
 		inline static String fromCString(function<size_t(char*,size_t)> todo, const size_t size) {
 			return String(Data<uint8_t>::fromCBuffer([&todo](void* buffer, size_t length) {
@@ -84,64 +115,78 @@ namespace fart::types {
 			}, size));
 		}
 
-		virtual ~String() {}
+		virtual ~String() {
+			_invalidateCString();
+		}
 
 		static
-		__attribute__ ((format (printf, 1, 0)))
+		__attribute__ ((format (printf, 1, 2)))
 		String format(const char* format, ...) {
-
+			Builder builder;
 			va_list args;
-
-			va_start(args, format);
-
-			size_t size = vsnprintf(nullptr, 0, format, args) + 1;
-
-			va_end(args);
-
 			va_start(args, format);
-
-			char buffer[size];
-
-			vsnprintf(buffer, size, format, args);
-
+			builder._appendFormat(format, args);
 			va_end(args);
+			return builder.string();
+		}
 
-			return String((const char*)buffer);
-
+		// Tells if this is the string of the atom table (see Atoms).
+		inline bool isAtom() const {
+			return _atom;
 		}
 
 		inline size_t length() const {
-			return _storage.length();
+			return _storage.length() >> _shift();
 		}
 
+		// The C string functions encode the string once, and keep it until the string changes.
+
 		template<typename T>
 		inline T mapCString(const function<T(const char*)>& todo) const {
-			return todo((const char*)this->UTF8Data(true)->items());
+			Strong<CString> cString = _cStringValue();
+			return todo(cString->string());
 		}
 
 		inline void withCString(const function<void(const char*)>& todo) const {
-			todo((const char*)this->UTF8Data(true)->items());
+			Strong<CString> cString = _cStringValue();
+			todo(cString->string());
 		}
 
 		template<typename T>
 		inline T withCString(function<T(const char*)> todo) const {
-			return todo((const char*)this->UTF8Data(true)->items());
+			Strong<CString> cString = _cStringValue();
+			return todo(cString->string());
 		}
 
 		inline void print(bool newLine = true) const {
-			this->appending(newLine ? "\n" : "")->withCString(printf);
+			Strong<CString> cString = _cStringValue();
+			printf(newLine ? "%s\n" : "%s", cString->string());
 		}
 
-		inline Strong<Data<uint8_t>> UTF8Data(bool nullTerminate = false) const {
-			return _encodeUTF8(_storage, nullTerminate);
+		Strong<Data<uint8_t>> UTF8Data(bool nullTerminate = false) const {
+			return _withUnits([&](auto units) {
+				size_t count = Transcoder::measureEncodedUTF8(units, this->length());
+				// ASCII is its own UTF-8.
+				if (_width == 1 && count == _storage.length() && !nullTerminate) return Strong<Data<uint8_t>>(_storage);
+				return _encodeUTF8(units, this->length(), count, nullTerminate);
+			});
 		}
 
 		inline Strong<Data<uint16_t>> UTF16Data(Endian::Variant endian = Endian::systemVariant(), bool includeBOM = false) const {
-			return _encodeUTF16(_storage, endian, includeBOM);
+			return _withUnits([&](auto units) {
+				return _encodeUTF16(units, this->length(), endian, includeBOM);
+			});
 		}
 
-		inline Strong<Data<uint32_t>> UTF32Data() const {
-			return Strong<Data<uint32_t>>(this->_storage);
+		Strong<Data<uint32_t>> UTF32Data() const {
+			if (_width == 4) return Strong<Data<uint32_t>>(_units<uint32_t>(), this->length());
+			Strong<Data<uint32_t>> result(this->length());
+			_withUnits([&](auto units) {
+				_convert<uint32_t>(units, this->length(), [&result](const uint32_t* converted, size_t length) {
+					result->append(converted, length);
+				});
+			});
+			return result;
 		}
 
 		inline static Strong<String> fromHex(const Data<uint8_t>& data) {
@@ -149,52 +194,73 @@ namespace fart::types {
 		}
 
 		inline Strong<Data<uint8_t>> hexData() const {
-			return _encodeHex(_storage);
+			return _encodeHex(*this);
 		}
 
-		inline void append(const String& other) {
-			_storage.append(other._storage);
+		void append(const String& other) {
+			other._withUnits([&](auto units) {
+				this->_appendUnits(units, other.length());
+			});
 		}
 
 		inline void append(uint32_t character) {
-			_storage.append(character);
+			_appendUnits(&character, 1);
 		}
 
 		inline Strong<String> appending(const String& other) const {
-			return String(this->_storage.appending(other._storage));
+			Strong<String> result(*this);
+			result->append(other);
+			return result;
 		}
 
-		inline Strong<Array<String>> split() const {
-			return _storage.split()->map<String>([](Data<uint32_t>& data) {
-				return Strong<String>(data);
-			});
+		Strong<Array<String>> split() const {
+			Strong<Array<String>> result;
+			for (size_t idx = 0 ; idx < this->length() ; idx++) {
+				result->append(Strong<String>(this->_unit(idx)));
+			}
+			return result;
 		}
 
 		inline Strong<Array<String>> split(const String& separator, IncludeSeparator includeSeparator = IncludeSeparator::none, size_t max = 0) const {
-			return _storage.split(separator._storage, includeSeparator, max)->map<String>([](const Data<uint32_t>& current) {
-				return Strong<String>(current);
-			});
+			return split(Array<String>(Strong<String>(separator)), includeSeparator, max);
 		}
 
 		Strong<Array<String>> split(const Array<String>& separators, IncludeSeparator includeSeparator = IncludeSeparator::none, size_t max = 0) const {
-			auto stores = separators.map<Data<uint32_t>>([](const String& current) {
-				return current._storage;
-			});
-			return _storage.split(stores, includeSeparator, max)->map<String>([](const Data<uint32_t>& current) {
-				return Strong<String>(current);
+			return _withUnits([&](auto units) {
+				using U = remove_const_t<remove_pointer_t<decltype(units)>>;
+				Array<Data<U>> stores;
+				separators.forEach([&](const String& separator) {
+					// Wider separators are not in the string.
+					if (separator._width > this->_width) return;
+					stores.append(Strong<Data<U>>(separator._storageOfWidth(this->_width).template as<U>()));
+				});
+				Strong<Array<Data<U>>> parts;
+				if constexpr (is_same<U, uint8_t>::value) parts = _storage.split(stores, includeSeparator, max);
+				else parts = Data<U>(units, this->length()).split(stores, includeSeparator, max);
+				return parts->template map<String>([](const Data<U>& part) {
+					Strong<String> result;
+					if constexpr (is_same<U, uint8_t>::value) result->_storage = part;
+					else result->_appendUnits(part.items(), part.length());
+					return result;
+				});
 			});
 		}
 
+		static Strong<String> join(const Array<String>& strings, const String* separator) {
+			Strong<String> result;
+			for (size_t idx = 0 ; idx < strings.count() ; idx++) {
+				if (separator != nullptr && idx > 0) result->append(*separator);
+				result->append(strings[idx]);
+			}
+			return result;
+		}
+
 		inline static Strong<String> join(const Array<String>& strings) {
-			return Strong<String>(Data<uint32_t>::join(strings.map<Data<uint32_t>>([](const String& current) {
-				return current._storage;
-			})));
+			return join(strings, nullptr);
 		}
 
 		inline static Strong<String> join(const Array<String>& strings, const String& separator) {
-			return Strong<String>(Data<uint32_t>::join(strings.map<Data<uint32_t>>([](const String& current) {
-				return current._storage;
-			}), separator._storage));
+			return join(strings, &separator);
 		}
 
 		Strong<String> replacing(const String& needle, const String& replacement) const {
@@ -203,110 +269,46 @@ namespace fart::types {
 
 		double doubleValue(size_t startIndex = 0, size_t* consumed = nullptr, bool allowLeadingZero = true) const {
 
-			double integerMultiplier = 1;
-			bool integerMultiplierParsed = false;
-			bool integerHadLeadingZero = false;
-			bool integerHadDigits = false;
-			size_t integerStartIndex = NotFound;
-			double fractionMultiplier = 10;
-			bool fractionHadDigits = false;
-			size_t fractionStartIndex = NotFound;
-			double exponentMultiplier = 1;
-			bool exponentMultiplierParsed = false;
-			bool exponentHadDigits = false;
-			size_t exponentStartIndex = NotFound;
-
-			double integer = 0;
-			double fraction = 0;
-			double exponent = 0;
-
-			size_t idx = startIndex;
-			while (idx < length()) {
-
-				uint32_t chr = _storage[idx];
-
-				if (chr == '+' || chr == '-') {
-
-					if (fractionStartIndex != NotFound && exponentStartIndex == NotFound) throw DecoderException(idx);
-					if (exponentStartIndex == NotFound && integerMultiplierParsed) throw DecoderException(idx);
-					if (exponentStartIndex != NotFound && exponentMultiplierParsed) throw DecoderException(idx);
-
-					if (exponentStartIndex != NotFound) {
-						if (exponentHadDigits) throw DecoderException(idx);
-						exponentMultiplier = chr == '+' ? 1 : -1;
-						exponentMultiplierParsed = true;
-					}
-					else {
-						if (integerHadDigits) throw DecoderException(idx);
-						integerMultiplier = chr == '+' ? 1 : -1;
-						integerMultiplierParsed = true;
-					}
-
-				}
-
-				else if (chr == '.') {
-					if (!integerHadDigits) throw DecoderException(idx);
-					if (exponentStartIndex != NotFound || fractionStartIndex != NotFound) throw DecoderException(idx);
-					fractionStartIndex = idx;
-				}
-
-				else if (chr == 'e' || chr == 'E') {
-					if (exponentStartIndex != NotFound) throw DecoderException(idx);
-					exponentStartIndex = idx;
-				}
-
-				else if (chr >= '0' && chr <= '9') {
+			startIndex = math::min(startIndex, this->length());
 
-					if (exponentStartIndex != NotFound && !exponentHadDigits) exponentHadDigits = true;
-					else if (fractionStartIndex != NotFound && !fractionHadDigits) fractionHadDigits = true;
-					else if (!integerHadDigits) {
-						integerHadDigits = true;
-						integerHadLeadingZero = chr == '0';
-					}
-
-					double value = chr - '0';
-
-					if (exponentStartIndex != NotFound) {
-						exponent = exponent * 10 + value;
-					} else if (fractionStartIndex != NotFound) {
-						fraction = fraction + (value / fractionMultiplier);
-						fractionMultiplier *= 10;
-					} else {
-						integer = integer * 10 + value;
-					}
-
-				} else {
-					break;
-				}
-
-				idx++;
+			FloatingPoint::Literal literal;
 
+			try {
+				literal = _withUnits([&](auto units) {
+					return FloatingPoint::parse(units + startIndex, this->length() - startIndex, allowLeadingZero);
+				});
+			} catch (const DecoderException& exception) {
+				throw DecoderException(startIndex + exception.characterIndex());
 			}
 
-			if (consumed != nullptr) *consumed = idx - startIndex;
-
-			if (exponentStartIndex != NotFound && !exponentHadDigits) throw DecoderException(exponentStartIndex);
-			if (fractionStartIndex != NotFound && !fractionHadDigits) throw DecoderException(fractionStartIndex);
-			if (!integerHadDigits) throw DecoderException(startIndex);
+			if (consumed != nullptr) *consumed = literal.length;
 
-			double result = ((integer * integerMultiplier) + fraction) * (pow(10, exponent) * exponentMultiplier);
-
-			if (!allowLeadingZero && integer != 0 && integerHadLeadingZero) throw DecoderException(integerStartIndex);
-
-			return result;
+			return literal.value;
 
 		}
 
-		inline size_t indexOf(const String& other, size_t offset = 0) const {
-			return this->_storage.indexOf(other._storage, offset);
+		size_t indexOf(const String& other, size_t offset = 0) const {
+			if (other._width > _width || offset >= this->length()) return NotFound;
+			Data<uint8_t> needle = other._storageOfWidth(_width);
+			return _withUnits([&](auto units) {
+				using U = remove_const_t<remove_pointer_t<decltype(units)>>;
+				size_t index = Search::first(units + offset, this->length() - offset, (const U*)needle.items(), other.length());
+				return index == Search::notFound ? NotFound : offset + index;
+			});
 		}
 
 		inline size_t indexOf(uint32_t chr) const {
-			return this->_storage.indexOf(chr);
+			return this->indexOf(String(chr));
 		}
 
-		inline size_t lastIndexOf(const String& other) const {
-			return this->_storage.lastIndexOf(other._storage);
+		size_t lastIndexOf(const String& other) const {
+			if (other._width > _width) return NotFound;
+			Data<uint8_t> needle = other._storageOfWidth(_width);
+			return _withUnits([&](auto units) {
+				using U = remove_const_t<remove_pointer_t<decltype(units)>>;
+				size_t index = Search::last(units, this->length(), (const U*)needle.items(), other.length());
+				return index == Search::notFound ? NotFound : index;
+			});
 		}
 
 		bool contains(const String& other) const {
@@ -314,61 +316,83 @@ namespace fart::types {
 		}
 
 		bool hasPrefix(const String& other) const {
-			return this->_storage.hasPrefix(other._storage);
+			return this->_needle(other, 0);
 		}
 
 		bool hasSuffix(const String& other) const {
-			return this->_storage.hasSuffix(other._storage);
+			if (other.length() > this->length()) return false;
+			return this->_needle(other, this->length() - other.length());
 		}
 
 		inline Strong<String> substring(size_t offset, size_t length = NotFound) const {
-			return Strong<String>(_storage.subdata(offset, length));
+			if (length == NotFound) length = this->length();
+			return _substring(offset, (size_t)math::min((ssize_t)this->length() - (ssize_t)offset, (ssize_t)length));
 		}
 
-		inline Strong<String> slicing(ssize_t start = 0, ssize_t end = math::limit<ssize_t>()) const {
-			return Strong<String>(_storage.slicing(start, end));
+		Strong<String> slicing(ssize_t start = 0, ssize_t end = math::limit<ssize_t>()) const {
+
+			ssize_t length = this->length();
+
+			if (start < 0) {
+				start = (length - 1) + start;
+			}
+
+			if (end < 0) {
+				end = (length - 1) + end;
+			}
+
+			end = math::min<ssize_t>(length - 1, math::max<ssize_t>(-1, end));
+			start = math::max<ssize_t>(0, math::min<ssize_t>(length, start));
+
+			return _substring(start, math::max<ssize_t>(0, math::min<ssize_t>(length, end - start + 1)));
+
 		}
 
 		inline Strong<String> uppercased() const {
-			return Strong<String>(this->_storage.map<uint32_t>(Unicode::lowerToUpper));
+			return _withUnits([&](auto units) {
+				return _mapped(units, [&](auto result) {
+					return Unicode::uppercase(units, this->length(), result);
+				});
+			});
 		}
 
 		inline Strong<String> lowercased() const {
-			return String(this->_storage.map<uint32_t>(Unicode::upperToLower));
+			return _withUnits([&](auto units) {
+				return _mapped(units, [&](auto result) {
+					return Unicode::lowercase(units, this->length(), result);
+				});
+			});
 		}
 
 		inline Strong<String> capitalized() const {
 			if (this->length() == 0) return Strong<String>();
-			if (this->length() == 1) return this->uppercased();
-			return this->substring(0, 1)->uppercased()->appending(this->substring(1)->lowercased());
+			return _withUnits([&](auto units) {
+				return _mapped(units, [&](auto result) {
+					return Unicode::uppercase(units, 1, result) | Unicode::lowercase(units + 1, this->length() - 1, result + 1);
+				});
+			});
 		}
 
 		Strong<String> trimmedStart() const {
-
-			ssize_t start = 0;
-
-			while (start < (ssize_t)this->_storage.length() && Unicode::isWhitespace(this->_storage[start])) {
-				start++;
-			}
-
-			return this->substring(start);
-
+			size_t start = _withUnits([&](auto units) {
+				return Unicode::whitespaceStart(units, this->length());
+			});
+			return _substring(start, this->length() - start);
 		}
 
 		Strong<String> trimmedEnd() const {
-
-			ssize_t end = this->_storage.length() - 1;
-
-			while (end > 0 && Unicode::isWhitespace(this->_storage[end])) {
-				end--;
-			}
-
-			return this->substring(0, end + 1);
-
+			size_t end = _withUnits([&](auto units) {
+				return Unicode::whitespaceEnd(units, this->length());
+			});
+			return _substring(0, this->length() - end);
 		}
 
 		Strong<String> trimmed() const {
-			return this->trimmedStart()->trimmedEnd();
+			return _withUnits([&](auto units) {
+				size_t start = Unicode::whitespaceStart(units, this->length());
+				size_t end = Unicode::whitespaceEnd(units + start, this->length() - start);
+				return _substring(start, this->length() - start - end);
+			});
 		}
 
 		virtual uint64_t hash() const override {
@@ -381,210 +405,796 @@ namespace fart::types {
 
 		virtual bool operator==(const Type& other) const override {
 			if (!other.is(Type::Kind::string)) return false;
-			return _storage == ((const String&)other)._storage;
+			const String& string = (const String&)other;
+			// Atoms are unique by their contents.
+			if (_atom && string._atom) return this == &string;
+			return _width == string._width && _storage.equals(string._storage);
 		}
 
 		inline bool operator==(const char* other) const {
 			return *this == String(other);
 		}
 
+		// Tells if the string is the same as other when both are lower cased - without making them.
+		bool equalsIgnoringCase(const String& other) const {
+			if (this == &other) return true;
+			// Lower casing maps one code point to one.
+			if (this->length() != other.length()) return false;
+			return _withUnits([&](auto units) {
+				return other._withUnits([&](auto others) {
+					return Unicode::equalIgnoringCase(units, others, this->length());
+				});
+			});
+		}
+
+		// A hash of the string lower cased, without making it - equal for strings that are equal
+		// ignoring case, whatever their width.
+		uint64_t hashIgnoringCase() const {
+			return _withUnits([&](auto units) {
+				using U = remove_const_t<remove_pointer_t<decltype(units)>>;
+				size_t length = this->length();
+				Hashable::Stream stream;
+				// Room for whole stripes, and a chunk of the widest code points after a partial one.
+				uint8_t bytes[_hashChunkLength * 3 + Hashable::Stream::stripeSize];
+				if constexpr (sizeof(U) == 1) {
+					// Lower casing does not leave Latin-1, so the bytes are the code points.
+					size_t idx = 0;
+					for ( ; length - idx > _hashChunkLength * 2 ; idx += _hashChunkLength * 2) {
+						Unicode::lowercase(units + idx, _hashChunkLength * 2, bytes);
+						stream.update(bytes, _hashChunkLength * 2);
+					}
+					Unicode::lowercase(units + idx, length - idx, bytes);
+					return stream.finish(bytes, length - idx);
+				} else {
+					// As above for code points below 0x100, followed by their higher bytes otherwise.
+					uint32_t lowered[_hashChunkLength];
+					size_t count = 0;
+					for (size_t idx = 0 ; idx < length ; idx += _hashChunkLength) {
+						size_t chunk = math::min(length - idx, _hashChunkLength);
+						Unicode::lowercase(units + idx, chunk, lowered);
+						for (size_t offset = 0 ; offset < chunk ; offset++) {
+							uint32_t codePoint = lowered[offset];
+							bytes[count++] = (uint8_t)codePoint;
+							if (codePoint >= 0x100) bytes[count++] = (uint8_t)(codePoint >> 8);
+							if (codePoint >= 0x10000) bytes[count++] = (uint8_t)(codePoint >> 16);
+						}
+						size_t consumed = stream.update(bytes, count);
+						memmove(bytes, bytes + consumed, count - consumed);
+						count -= consumed;
+					}
+					return stream.finish(bytes, count);
+				}
+			});
+		}
+
+		// A key policy for Dictionary, which ignores case.
+		struct CaseInsensitive {
+
+			static inline uint64_t hash(const String& key) {
+				return key.hashIgnoringCase();
+			}
+
+			static inline bool equals(const String& key, const String& other) {
+				return key.equalsIgnoringCase(other);
+			}
+
+		};
+
 		virtual bool operator>(const String& other) const override {
-			return this->lowercased()->_storage > other.lowercased()->_storage;
+			return _withUnits([&](auto units) {
+				return other._withUnits([&](auto others) {
+					size_t length = math::min(this->length(), other.length());
+					for (size_t idx = 0 ; idx < length ; idx++) {
+						uint32_t character = Unicode::upperToLower(units[idx]);
+						uint32_t otherCharacter = Unicode::upperToLower(others[idx]);
+						if (character != otherCharacter) return character > otherCharacter;
+					}
+					return this->length() > other.length();
+				});
+			});
 		}
 
 		inline uint32_t operator[](size_t idx) const {
-			return _storage[idx];
+			if (idx >= this->length()) throw OutOfBoundException(idx);
+			return _unit(idx);
 		}
 
 		String& operator=(const String& other) {
 			Type::operator=(other);
+			CString* cString = other._retainedCString();
+			_invalidateCString();
 			_storage = other._storage;
+			_width = other._width;
+			_cString = cString;
 			return *this;
 		}
 
 		String& operator=(String&& other) {
 			Type::operator=(std::move(other));
+			CString* cString = other._cString.exchange(nullptr);
+			_invalidateCString();
 			_storage = std::move(other._storage);
+			_width = other._width;
+			_cString = cString;
+			other._width = 1;
 			return *this;
 		}
 
-	private:
+		// Builds a string by appending, kept as UTF-8 in a buffer that grows by doubling, so it can
+		// also be taken as UTF-8 without conversion. Data of FART_STRING_BUILDER_ROPE_LENGTH bytes
+		// or more is not copied into the buffer, but kept as a piece of a rope, and only copied
+		// when the result is made.
+		class Builder {
 
-		enum class DoublePart {
-			integer = 0,
-			fraction,
-			exponent
-		};
+			friend class String;
 
-		DataValue<uint32_t> _storage;
+		public:
 
-		template<typename T>
-		static size_t _lengthWithoutNullTerminator(const Data<T>& data) {
-			size_t length = data.length();
-			if (length > 0 && data.itemAtIndex(length - 1) == 0) {
-				return length - 1;
+			Builder(size_t capacity = 0) : _pieces(), _piecesLength(0), _buffer(capacity) {}
+
+			// Makes room for length more bytes of UTF-8.
+			inline void reserve(size_t length) {
+				_buffer.reserve(_buffer.length() + length);
+			}
+
+			// The length of the UTF-8 appended.
+			inline size_t length() const {
+				return _piecesLength + _buffer.length();
 			}
-			return length;
-		}
 
-		static Data<uint32_t> _decodeUTF8(const uint8_t* buffer, size_t length) noexcept(false) {
+			Builder& append(const String& string) {
+				string._withUnits([&](auto units) {
+					size_t length = string.length();
+					size_t count = Transcoder::measureEncodedUTF8(units, length);
+					// ASCII is its own UTF-8.
+					if (string._width == 1 && count == length && count >= FART_STRING_BUILDER_ROPE_LENGTH) {
+						_appendPiece(string._storage);
+					} else {
+						_buffer.appendCBuffer([&](uint8_t* bytes, size_t) {
+							Transcoder::encodeUTF8(units, length, bytes, count);
+							return count;
+						}, count);
+					}
+				});
+				return *this;
+			}
 
-			size_t offset = 0;
+			// Appends UTF-8 (or any bytes, if the result is only taken as UTF-8 data).
+			Builder& append(const Data<uint8_t>& data) {
+				if (data.length() >= FART_STRING_BUILDER_ROPE_LENGTH) _appendPiece(data);
+				else _buffer.append(data);
+				return *this;
+			}
 
-			if (length > 2 && buffer[0] == 0xEF && buffer[1] == 0xBB && buffer[2] == 0xBF) {
-				offset += 3;
+			inline Builder& append(const char* string, size_t length) {
+				_buffer.append((const uint8_t*)string, length);
+				return *this;
 			}
 
-			Data<uint32_t> ret;
+			inline Builder& append(const char* string) {
+				return this->append(string, strlen(string));
+			}
 
-			for (size_t idx = offset ; idx < length ; idx++) {
-
-				const uint8_t firstByte = buffer[0];
-				uint32_t codePoint = 0;
-				uint8_t charWidth = 1;
-
-				buffer++;
-
-				if ((firstByte & 0x80) == 0) {
-					codePoint = firstByte & 0x7F;
-				} else if ((firstByte & 0xE0) == 0xC0) {
-					charWidth = 2;
-					codePoint = firstByte & 0x1F;
-				} else if ((firstByte & 0xF0) == 0xE0) {
-					charWidth = 3;
-					codePoint = firstByte & 0x0F;
-				} else if ((firstByte & 0xF8) == 0xF0) {
-					charWidth = 4;
-					codePoint = firstByte & 0x07;
-				} else { // Malformed.
-					throw DecoderException(idx);
+			Builder& append(uint32_t character) {
+				if (character < 0x80) {
+					_buffer.append((uint8_t)character);
+					return *this;
 				}
+				size_t count = Transcoder::measureEncodedUTF8(&character, 1);
+				_buffer.appendCBuffer([&](uint8_t* bytes, size_t) {
+					Transcoder::encodeUTF8(&character, 1, bytes, count);
+					return count;
+				}, count);
+				return *this;
+			}
+
+			__attribute__ ((format (printf, 2, 3)))
+			Builder& appendFormat(const char* format, ...) {
+				va_list args;
+				va_start(args, format);
+				this->_appendFormat(format, args);
+				va_end(args);
+				return *this;
+			}
+
+			// Appends format with each {} replaced by the next argument, which is written by its
+			// type, so they cannot mismatch - types without a way to be written do not compile.
+			// Options follow a colon: 0 to pad with zeros, a minimum width, a precision for floats,
+			// and x or X for hexadecimal integers - as in {:08X} or {:.2}. Floats without a
+			// precision are written in their shortest form. {{ and }} are literal braces.
+			//
+			// Throws FormatException if the placeholders and the arguments do not add up.
+			template<typename... Args>
+			Builder& format(const char* format, const Args&... args) noexcept(false) {
+				// One more, as arrays cannot be empty.
+				const Argument arguments[] = { Argument(args)..., Argument() };
+				this->_format(format, arguments, sizeof...(Args));
+				return *this;
+			}
+
+			Strong<Data<uint8_t>> UTF8Data() const {
+				if (_pieces.count() == 0) return Strong<Data<uint8_t>>(_buffer);
+				return Strong<Data<uint8_t>>(Data<uint8_t>::fromCBuffer([&](uint8_t* bytes, size_t) {
+					size_t offset = 0;
+					for (size_t idx = 0 ; idx < _pieces.count() ; idx++) {
+						Strong<Data<uint8_t>> piece = _pieces[idx];
+						memcpy(bytes + offset, piece->items(), piece->length());
+						offset += piece->length();
+					}
+					memcpy(bytes + offset, _buffer.items(), _buffer.length());
+					return offset + _buffer.length();
+				}, this->length()));
+			}
+
+			Strong<String> string() const noexcept(false) {
+				Strong<Data<uint8_t>> data = this->UTF8Data();
+				Strong<String> result;
+				result->_decodeUTF8(data->items(), data->length(), data, false);
+				return result;
+			}
+
+		private:
+
+			Array<Data<uint8_t>> _pieces;
+			size_t _piecesLength;
+			Data<uint8_t> _buffer;
+
+			struct Options {
+				bool zeros = false;
+				size_t width = 0;
+				int precision = -1;
+				bool hexadecimal = false;
+				bool uppercase = false;
+			};
+
+			// A reference to an argument of format, with the function that writes its type.
+			class Argument {
+
+			public:
+
+				Argument() : _value(nullptr), _write(nullptr) {}
+
+				template<typename T>
+				Argument(const T& value) : _value(&value), _write(&Builder::_writeArgument<T>) {}
 
-				// Malformed.
-				if (length < charWidth) {
-					throw DecoderException(idx);
+				inline void write(Builder& builder, const Options& options) const {
+					_write(builder, options, _value);
 				}
 
-				for (int64_t i = 1 ; i < charWidth ; i++) {
-					if ((buffer[0] & 0xC0) == 0x80) {
-						codePoint = (codePoint << 6) | (buffer[0] & 0x3F);
-					} else {
-						// Malformed.
-						throw DecoderException(idx);
+			private:
+
+				const void* _value;
+				void (*_write)(Builder&, const Options&, const void*);
+
+			};
+
+			template<typename T>
+			static void _writeArgument(Builder& builder, const Options& options, const void* value) {
+				builder._write(options, *(const T*)value);
+			}
+
+			void _appendFormat(const char* format, va_list args) {
+
+				va_list measure;
+				va_copy(measure, args);
+				int length = vsnprintf(nullptr, 0, format, measure);
+				va_end(measure);
+
+				if (length <= 0) return;
+
+				// Room for the null terminator, which is not kept.
+				_buffer.appendCBuffer([&](uint8_t* bytes, size_t size) {
+					vsnprintf((char*)bytes, size, format, args);
+					return (size_t)length;
+				}, length + 1);
+
+			}
+
+			void _format(const char* format, const Argument* arguments, size_t count) noexcept(false) {
+
+				size_t next = 0;
+				const char* literal = format;
+				const char* position = format;
+
+				for ( ; *position != '\0' ; position++) {
+
+					if (*position != '{' && *position != '}') continue;
+
+					this->append(literal, position - literal);
+
+					if (position[1] == *position) {
+						literal = ++position;
+						continue;
+					}
+
+					if (*position == '}' || next == count) throw FormatException();
+
+					Options options;
+					position = _options(position + 1, &options);
+
+					arguments[next++].write(*this, options);
+
+					literal = position + 1;
+
+				}
+
+				this->append(literal, position - literal);
+
+				if (next != count) throw FormatException();
+
+			}
+
+			// Reads the options of a placeholder, and returns the position of its closing brace.
+			static const char* _options(const char* position, Options* options) noexcept(false) {
+
+				if (*position == '}') return position;
+				if (*position++ != ':') throw FormatException();
+
+				if (*position == '0') {
+					options->zeros = true;
+					position++;
+				}
+
+				for ( ; *position >= '0' && *position <= '9' ; position++) {
+					options->width = options->width * 10 + (*position - '0');
+				}
+
+				if (*position == '.') {
+					options->precision = 0;
+					for (position++ ; *position >= '0' && *position <= '9' ; position++) {
+						options->precision = options->precision * 10 + (*position - '0');
 					}
-					buffer++;
-					idx++;
 				}
 
-				ret.append(codePoint);
+				if (*position == 'x' || *position == 'X') {
+					options->hexadecimal = true;
+					options->uppercase = *position++ == 'X';
+				}
+
+				if (*position != '}') throw FormatException();
+
+				return position;
 
 			}
 
-			return ret;
+			// Appends the padding up to the width of options in front of characters, and the sign
+			// before or after it.
+			void _pad(const Options& options, size_t characters, bool negative) {
+				size_t padding = options.width > characters ? options.width - characters : 0;
+				if (!options.zeros) _fill(' ', padding);
+				if (negative) _buffer.append('-');
+				if (options.zeros) _fill('0', padding);
+			}
 
-		}
+			void _fill(uint8_t fill, size_t count) {
+				if (count == 0) return;
+				_buffer.appendCBuffer([&](uint8_t* bytes, size_t length) {
+					memset(bytes, fill, length);
+					return length;
+				}, count);
+			}
 
-		static Data<uint8_t> _encodeUTF8(const Data<uint32_t> &buffer, bool nullTerminate = false) noexcept(false) {
+			void _writeInteger(const Options& options, uint64_t value, bool negative) {
 
-			Data<uint8_t> ret;
+				uint64_t base = options.hexadecimal ? 16 : 10;
+				const char* digits = options.uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
 
-			for (size_t idx = 0 ; idx < buffer.length() ; idx++) {
+				size_t count = 1;
+				for (uint64_t remaining = value / base ; remaining > 0 ; remaining /= base) count++;
+
+				_pad(options, count + negative, negative);
+
+				_buffer.appendCBuffer([&](uint8_t* bytes, size_t length) {
+					for (size_t idx = length ; idx > 0 ; idx--) {
+						bytes[idx - 1] = digits[value % base];
+						value /= base;
+					}
+					return length;
+				}, count);
+
+			}
+
+			template<typename T>
+			typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type _write(const Options& options, T value) {
+				bool negative = value < 0;
+				// Negated unsigned, so the smallest value does not overflow.
+				_writeInteger(options, negative ? 0 - (uint64_t)value : (uint64_t)value, negative);
+			}
+
+			template<typename T>
+			typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type _write(const Options& options, T value) {
+				_writeInteger(options, (uint64_t)value, false);
+			}
+
+			template<typename T>
+			typename std::enable_if<std::is_enum<T>::value>::type _write(const Options& options, T value) {
+				_write(options, (typename std::underlying_type<T>::type)value);
+			}
+
+			void _write(const Options& options, bool value) {
+				_write(options, value ? "true" : "false");
+			}
+
+			void _write(const Options& options, char value) {
+				_pad(options, 1, false);
+				_buffer.append((uint8_t)value);
+			}
+
+			void _write(const Options& options, double value) {
+
+				if (options.precision < 0) {
+					char buffer[FloatingPoint::maximumLength];
+					size_t length = FloatingPoint::format(value, buffer);
+					bool negative = buffer[0] == '-';
+					_pad(options, length, negative);
+					_buffer.append((const uint8_t*)buffer + negative, length - negative);
+					return;
+				}
+
+				const char* format = options.zeros ? "%0*.*f" : "%*.*f";
+				int width = (int)options.width;
+				int length = snprintf(nullptr, 0, format, width, options.precision, value);
+				_buffer.appendCBuffer([&](uint8_t* bytes, size_t size) {
+					snprintf((char*)bytes, size, format, width, options.precision, value);
+					return (size_t)length;
+				}, length + 1);
+
+			}
+
+			inline void _write(const Options& options, float value) {
+				_write(options, (double)value);
+			}
 
-				uint8_t chr[4];
-
-				uint32_t codePoint = buffer[idx];
-				if (codePoint < 0x80) {
-					ret.append(codePoint);
-				} else if (codePoint < 0x800) {
-					uint8_t chr[2];
-					chr[0] = 0xC0 | (codePoint >> 6);
-					chr[1] = 0x80 | (codePoint & 0x3F);
-					ret.append(chr, 2);
-				} else if (codePoint <= 0xFFFF) {
-					chr[0] = 0xE0 | (codePoint >> 12);
-					chr[1] = 0x80 | ((codePoint >> 6) & 0x3F);
-					chr[2] = 0x80 | (codePoint & 0x3F);
-					ret.append(chr, 3);
-				} else if (codePoint <= 0x1FFFFF) {
-					chr[0] = 0xF0 | (codePoint >> 18);
-					chr[1] = 0x80 | ((codePoint >> 12) & 0x3F);
-					chr[2] = 0x80 | ((codePoint >> 6) & 0x3F);
-					chr[3] = 0x80 | (codePoint & 0x3F);
-					ret.append(chr, 4);
+			void _write(const Options& options, const char* value) {
+				size_t length = strlen(value);
+				if (options.width > 0) _pad(options, _characters((const uint8_t*)value, length), false);
+				_buffer.append((const uint8_t*)value, length);
+			}
+
+			template<size_t N>
+			inline void _write(const Options& options, const char (&value)[N]) {
+				_write(options, (const char*)value);
+			}
+
+			void _write(const Options& options, const String& value) {
+				_pad(options, value.length(), false);
+				this->append(value);
+			}
+
+			inline void _write(const Options& options, const Strong<String>& value) {
+				_write(options, (const String&)value);
+			}
+
+			// The number of code points of UTF-8.
+			static size_t _characters(const uint8_t* bytes, size_t length) {
+				size_t result = 0;
+				for (size_t idx = 0 ; idx < length ; idx++) result += (bytes[idx] & 0xC0) != 0x80;
+				return result;
+			}
+
+			void _appendPiece(const Data<uint8_t>& data) {
+				if (_buffer.length() > 0) {
+					_piecesLength += _buffer.length();
+					_pieces.append(_buffer);
+					_buffer = Data<uint8_t>();
 				}
+				_piecesLength += data.length();
+				_pieces.append(data);
+			}
+
+		};
+
+	private:
 
+		static constexpr size_t _hashChunkLength = 64;
+
+		enum class DoublePart {
+			integer = 0,
+			fraction,
+			exponent
+		};
+
+		// The string as null terminated UTF-8. Copies of the string share it.
+		class CString : public Object {
+
+		public:
+
+			using Object::retain;
+			using Object::release;
+
+			CString(const Data<uint8_t>& data) : Object(), _data(data) {}
+
+			inline const char* string() const {
+				return (const char*)_data.items();
 			}
 
-			if (nullTerminate) ret.append('\0');
+		private:
 
-			return ret;
+			Data<uint8_t> _data;
 
+		};
+
+		// Code points of _width bytes each, in system byte order.
+		Data<uint8_t> _storage;
+		uint8_t _width;
+		// Set on the strings of the atom table only - not copies of them.
+		bool _atom;
+		// Made on first use, and holding a retain. It is atomic, so strings shared between threads
+		// can make it concurrently - the first one to be stored wins.
+		mutable std::atomic<CString*> _cString;
+
+		Strong<CString> _cStringValue() const {
+			CString* cString = _cString.load(std::memory_order_acquire);
+			if (cString == nullptr) {
+				CString* made = new CString(this->UTF8Data(true));
+				made->retain();
+				if (_cString.compare_exchange_strong(cString, made, std::memory_order_acq_rel, std::memory_order_acquire)) cString = made;
+				else made->release();
+			}
+			return Strong<CString>(cString);
 		}
 
-		static Data<uint32_t> _decodeUTF16(const uint16_t* buffer, size_t length, Endian::Variant endian) noexcept(false) {
+		CString* _retainedCString() const {
+			CString* cString = _cString.load(std::memory_order_acquire);
+			if (cString != nullptr) cString->retain();
+			return cString;
+		}
 
-			Data<uint32_t> ret;
+		inline void _invalidateCString() {
+			CString* cString = _cString.exchange(nullptr, std::memory_order_acq_rel);
+			if (cString != nullptr) cString->release();
+		}
 
-			for (size_t idx = 0 ; idx < length ; idx++) {
+		inline uint8_t _shift() const {
+			return _width >> 1;
+		}
 
-				uint16_t high = Endian::toSystemVariant(buffer[idx], endian);
+		inline static uint8_t _widthOf(uint32_t codePoint) {
+			return codePoint <= 0xFF ? 1 : (codePoint <= 0xFFFF ? 2 : 4);
+		}
 
-				if (!(high >= 0xD800 && high <= 0xD8FF) || idx + 1 == length) ret.append(high);
-				else {
+		template<typename U>
+		static uint8_t _widthOf(const U* units, size_t length) {
+			if constexpr (sizeof(U) == 1) return 1;
+			// As widths end at a power of two, the widest code point decides the width of all of them or'ed.
+			U bits = 0;
+			for (size_t idx = 0 ; idx < length ; idx++) {
+				bits |= units[idx];
+			}
+			return _widthOf(bits);
+		}
 
-					uint16_t low = Endian::toSystemVariant(buffer[idx + 1], endian);
+		template<typename U>
+		inline const U* _units() const {
+			return (const U*)_storage.items();
+		}
 
-					if (low >= 0xDC00 && low <= 0xDFFF) {
-						ret.append((((high & 0x3FF) << 10) | (low & 0x3FF)) + 0x10000);
-						idx++;
-					}
+		template<typename F>
+		inline auto _withUnits(F todo) const -> decltype(todo((const uint8_t*)nullptr)) {
+			switch (_width) {
+				case 1: return todo(_units<uint8_t>());
+				case 2: return todo(_units<uint16_t>());
+				default: return todo(_units<uint32_t>());
+			}
+		}
+
+		inline uint32_t _unit(size_t idx) const {
+			switch (_width) {
+				case 1: return _units<uint8_t>()[idx];
+				case 2: return _units<uint16_t>()[idx];
+				default: return _units<uint32_t>()[idx];
+			}
+		}
 
+		// Calls todo with the units converted to V in chunks.
+		template<typename V, typename U, typename F>
+		static void _convert(const U* units, size_t length, F todo) {
+			V converted[256];
+			for (size_t idx = 0 ; idx < length ; idx += 256) {
+				size_t count = math::min<size_t>(256, length - idx);
+				for (size_t offset = 0 ; offset < count ; offset++) {
+					converted[offset] = (V)units[idx + offset];
 				}
+				todo(converted, count);
+			}
+		}
 
+		template<typename V, typename U>
+		static void _appendConverted(Data<uint8_t>& storage, const U* units, size_t length) {
+			if constexpr (sizeof(U) == sizeof(V)) storage.append((const uint8_t*)units, length * sizeof(U));
+			else _convert<V>(units, length, [&storage](const V* converted, size_t count) {
+				storage.append((const uint8_t*)converted, count * sizeof(V));
+			});
+		}
+
+		template<typename U>
+		static void _append(Data<uint8_t>& storage, uint8_t width, const U* units, size_t length) {
+			switch (width) {
+				case 1: return _appendConverted<uint8_t>(storage, units, length);
+				case 2: return _appendConverted<uint16_t>(storage, units, length);
+				default: return _appendConverted<uint32_t>(storage, units, length);
 			}
+		}
 
-			return ret;
+		// Appends code points, widening the storage if any of them do not fit.
+		template<typename U>
+		void _appendUnits(const U* units, size_t length) {
+			if (length == 0) return;
+			_invalidateCString();
+			uint8_t width = _widthOf(units, length);
+			if (width > _width) {
+				Data<uint8_t> widened(this->length() * width + length * width);
+				_withUnits([&](auto current) {
+					_append(widened, width, current, this->length());
+				});
+				_storage = std::move(widened);
+				_width = width;
+			}
+			_append(_storage, _width, units, length);
+		}
 
+		// The storage as if it was width wide, which must be able to hold all code points.
+		Data<uint8_t> _storageOfWidth(uint8_t width) const {
+			if (width == _width) return _storage;
+			Data<uint8_t> result(this->length() * width);
+			_withUnits([&](auto units) {
+				_append(result, width, units, this->length());
+			});
+			return result;
 		}
 
-		static Data<uint16_t> _encodeUTF16(const Data<uint32_t>& buffer, Endian::Variant endian, bool includeBOM) noexcept(false) {
+		bool _needle(const String& other, size_t offset) const {
+			if (other._width > _width || offset + other.length() > this->length()) return false;
+			Data<uint8_t> needle = other._storageOfWidth(_width);
+			return memcmp(_storage.items() + (offset << _shift()), needle.items(), needle.length()) == 0;
+		}
 
-			Data<uint16_t> ret;
+		Strong<String> _substring(size_t offset, size_t length) const {
+			Strong<String> result;
+			if (_width == 1) {
+				result->_storage = _storage.subdata(offset, length);
+			} else {
+				_withUnits([&](auto units) {
+					result->_appendUnits(units + offset, length);
+				});
+			}
+			return result;
+		}
 
-			if (includeBOM) {
-				ret.append((endian == Endian::Variant::big ? bigEndianBOM : littleEndianBOM).as<uint16_t>());
+		// Lets todo map the units of this string into those of a new one. todo is called with a
+		// pointer to units as wide as these, must write one for each, and returns the code points
+		// it wrote or'ed together. Mapping rarely changes the width, but if it does, the result is
+		// mapped again or narrowed.
+		template<typename U, typename F>
+		Strong<String> _mapped(const U*, F todo) const {
+			uint32_t bits = 0;
+			Strong<String> result;
+			result->_width = _width;
+			result->_storage = Data<uint8_t>::fromCBuffer([&](uint8_t* bytes, size_t length) {
+				bits = todo((U*)bytes);
+				return length;
+			}, _storage.length());
+			uint8_t width = _widthOf(bits);
+			if (width > _width) {
+				result->_width = width;
+				result->_storage = Data<uint8_t>::fromCBuffer([&](uint8_t* bytes, size_t length) {
+					if (width == 2) todo((uint16_t*)bytes);
+					else todo((uint32_t*)bytes);
+					return length;
+				}, this->length() * width);
+			} else if (width < _width) {
+				Data<uint8_t> narrowed = result->_storageOfWidth(width);
+				result->_storage = std::move(narrowed);
+				result->_width = width;
 			}
+			return result;
+		}
 
-			for (size_t idx = 0 ; idx < buffer.length() ; idx++) {
+		template<typename T>
+		static size_t _lengthWithoutNullTerminator(const Data<T>& data) {
+			size_t length = data.length();
+			if (length > 0 && data.itemAtIndex(length - 1) == 0) {
+				return length - 1;
+			}
+			return length;
+		}
 
-				uint32_t chr = buffer[idx];
+		inline static bool _hasBOM(const uint8_t* buffer, size_t length) {
+			return length > 2 && buffer[0] == 0xEF && buffer[1] == 0xBB && buffer[2] == 0xBF;
+		}
 
-				if (chr <= 0xFFFF) ret.append(Endian::fromSystemVariant((uint16_t)chr, endian));
-				else {
-					chr -= 0x10000;
-					ret.append(Endian::fromSystemVariant(0xD800 + ((chr >> 10) & 0x3FF), endian));
-					ret.append(Endian::fromSystemVariant(0xDC00 + (chr & 0x3FF), endian));
+		// Decodes into the (empty) storage. ASCII is its own storage, which is shared with data if given.
+		void _decodeUTF8(const uint8_t* buffer, size_t length, const Data<uint8_t>* data = nullptr, bool skipBOM = true) noexcept(false) {
+
+			size_t offset = skipBOM && _hasBOM(buffer, length) ? 3 : 0;
+
+			uint32_t maximum;
+			size_t count = Transcoder::measureUTF8(buffer, length, &maximum, offset);
+
+			// Only ASCII takes one byte per code point.
+			if (count == length - offset) {
+				if (data != nullptr) _storage = *data->subdata(offset, count);
+				else _storage = Data<uint8_t>(buffer + offset, count);
+				return;
+			}
+
+			uint8_t width = _widthOf(maximum);
+			uint32_t bits = 0;
+
+			_storage = Data<uint8_t>::fromCBuffer([&](uint8_t* units, size_t) {
+				switch (width) {
+					case 1:
+						bits = Transcoder::decodeUTF8(buffer + offset, length - offset, units, count);
+						break;
+					case 2:
+						bits = Transcoder::decodeUTF8(buffer + offset, length - offset, (uint16_t*)units, count);
+						break;
+					default:
+						bits = Transcoder::decodeUTF8(buffer + offset, length - offset, (uint32_t*)units, count);
+						break;
 				}
+				return count * width;
+			}, count * width);
+
+			_width = width;
 
+			// Overlong encodings might fit a narrower width.
+			if (_widthOf(bits) < _width) {
+				_storage = _storageOfWidth(_widthOf(bits));
+				_width = _widthOf(bits);
 			}
 
-			return ret;
+		}
 
+		// Encodes into a single allocation of the exact size, count being the measured length.
+		template<typename U>
+		static Strong<Data<uint8_t>> _encodeUTF8(const U* units, size_t length, size_t count, bool nullTerminate) noexcept(false) {
+			size_t size = count + (nullTerminate ? 1 : 0);
+			return Strong<Data<uint8_t>>(Data<uint8_t>::fromCBuffer([&](uint8_t* bytes, size_t) {
+				Transcoder::encodeUTF8(units, length, bytes, count);
+				if (nullTerminate) bytes[count] = '\0';
+				return size;
+			}, size));
 		}
 
-		inline static Data<uint32_t> _decodeUTF32(const Data<uint32_t>& buffer, Endian::Variant endian) {
-			return buffer.map<uint32_t>([&endian](uint32_t character) {
-				return Endian::convert(character, endian, Endian::systemVariant());
-			});
+		void _decodeUTF16(const uint16_t* buffer, size_t length, Endian::Variant endian) noexcept(false) {
+
+			Data<uint32_t> ret;
+
+			for (size_t idx = 0 ; idx < length ; idx++) {
+
+				uint16_t high = Endian::toSystemVariant(buffer[idx], endian);
+
+				if (!(high >= 0xD800 && high <= 0xD8FF) || idx + 1 == length) ret.append(high);
+				else {
+
+					uint16_t low = Endian::toSystemVariant(buffer[idx + 1], endian);
+
+					if (low >= 0xDC00 && low <= 0xDFFF) {
+						ret.append((((high & 0x3FF) << 10) | (low & 0x3FF)) + 0x10000);
+						idx++;
+					}
+
+				}
+
+			}
+
+			_appendUnits(ret.items(), ret.length());
+
 		}
 
-		inline static Data<uint32_t> _encodeUTF32(const Data<uint32_t>& buffer, Endian::Variant endian) {
-			return buffer.map<uint32_t>([&endian](uint32_t character) {
-				return Endian::convert(character, Endian::systemVariant(), endian);
-			});
+		template<typename U>
+		static Strong<Data<uint16_t>> _encodeUTF16(const U* units, size_t length, Endian::Variant endian, bool includeBOM) noexcept(false) {
+			size_t offset = includeBOM ? 1 : 0;
+			size_t size = Transcoder::measureEncodedUTF16(units, length) + offset;
+			return Strong<Data<uint16_t>>(Data<uint16_t>::fromCBuffer([&](uint16_t* result, size_t) {
+				if (includeBOM) result[0] = Endian::fromSystemVariant<uint16_t>(0xFEFF, endian);
+				Transcoder::encodeUTF16(units, length, result + offset, endian != Endian::systemVariant());
+				return size;
+			}, size));
 		}
 
-		static uint8_t _valueFromHex(uint8_t chr, size_t idx) noexcept(false) {
+		static uint8_t _valueFromHex(uint32_t chr, size_t idx) noexcept(false) {
 			if (chr >= 'a' && chr <= 'f') return chr - ('a' - 'A');
 			if (chr >= 'A' && chr <= 'F') return (chr - 'A') + 10;
 			else if (chr >= '0' && chr <= '9') return chr - '0';
@@ -597,30 +1207,30 @@ namespace fart::types {
 			else throw EncoderException(idx);
 		}
 
-		static Data<uint32_t> _decodeHex(const Data<uint8_t>& buffer) noexcept(false) {
+		static String _decodeHex(const Data<uint8_t>& buffer) noexcept(false) {
 
 			if (buffer.length() % 2 != 0) throw OutOfBoundException(buffer.length() + 1);
 
-			Data<uint32_t> ret;
+			String ret;
 
 			for (size_t idx = 0 ; idx < buffer.length() ; idx++) {
 				auto byte = buffer[idx];
-				ret.append(_valueToHex((byte & 0xF0) >> 4, idx));
-				ret.append(_valueToHex(byte & 0x0F, idx));
+				uint8_t hex[2] = { _valueToHex((byte & 0xF0) >> 4, idx), _valueToHex(byte & 0x0F, idx) };
+				ret._storage.append(hex, 2);
 			}
 
 			return ret;
 
 		}
 
-		static Data<uint8_t> _encodeHex(const Data<uint32_t> &buffer) noexcept(false) {
+		static Data<uint8_t> _encodeHex(const String& string) noexcept(false) {
 
-			if (buffer.length() % 2 != 0) throw OutOfBoundException(buffer.length() + 1);
+			if (string.length() % 2 != 0) throw OutOfBoundException(string.length() + 1);
 
 			Data<uint8_t> ret;
 
-			for (size_t idx = 0 ; idx < buffer.length() ; idx += 2) {
-				ret.append(_valueFromHex(buffer[idx], idx) << 4 | _valueFromHex(buffer[idx + 1], idx + 1));
+			for (size_t idx = 0 ; idx < string.length() ; idx += 2) {
+				ret.append(_valueFromHex(string[idx], idx) << 4 | _valueFromHex(string[idx + 1], idx + 1));
 			}
 
 			return ret;
@@ -14,6 +14,7 @@
 #include "./type.hpp"
 #include "./data.hpp"
 #include "./string.hpp"
+#include "./atoms.hpp"
 #include "./number.hpp"
 #include "./array.hpp"
 #include "./dictionary.hpp"
@@ -9,6 +9,14 @@
 #ifndef unicode_hpp
 #define unicode_hpp
 
+#include <stdint.h>
+#include <stddef.h>
+
+#if !defined(FART_NO_SIMD) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define FART_UNICODE_X86
+#include <immintrin.h>
+#endif
+
 namespace fart::types {
 
 	class Unicode {
@@ -208,29 +216,212 @@ namespace fart::types {
 
 		static const size_t _whitespaceCharactersCount = sizeof(_whitespaceCharacters) / sizeof(uint16_t);
 
+		static constexpr size_t _blockCapacity = 16;
+
+		// Two stage lookup tables made from the ones above at compile time. Code points are
+		// looked up in blocks of 256 by their high byte - where block zero has nothing in it.
+		// A mapping of zero leaves the code point as it is.
+		struct Tables {
+
+			uint8_t blocks[256];
+			uint16_t uppers[_blockCapacity][256];
+			uint16_t lowers[_blockCapacity][256];
+			uint64_t whitespace[_blockCapacity][4];
+			size_t blockCount;
+			bool spacesOnly;
+
+			// Fails to compile if the tables need more than _blockCapacity blocks.
+			constexpr Tables() : blocks(), uppers(), lowers(), whitespace(), blockCount(1), spacesOnly(true) {
+				for (size_t idx = 0 ; idx < _lowerUpperCodePointPairCount ; idx += 2) {
+					uint16_t lower = _lowerUpperCodePointPairs[idx];
+					uint16_t upper = _lowerUpperCodePointPairs[idx + 1];
+					// The first pair wins, as it did when the pairs were searched.
+					uint16_t& toUpper = uppers[_block(lower)][lower & 0xFF];
+					if (toUpper == 0) toUpper = upper;
+					uint16_t& toLower = lowers[_block(upper)][upper & 0xFF];
+					if (toLower == 0) toLower = lower;
+				}
+				for (size_t idx = 0 ; idx < _whitespaceCharactersCount ; idx++) {
+					uint16_t codePoint = _whitespaceCharacters[idx];
+					whitespace[_block(codePoint)][(codePoint & 0xFF) >> 6] |= (uint64_t)1 << (codePoint & 0x3F);
+					spacesOnly = spacesOnly && (codePoint >= 0x100 || codePoint == 0x20 || codePoint == 0xA0);
+				}
+			}
+
+			constexpr uint8_t _block(uint16_t codePoint) {
+				uint8_t& block = blocks[codePoint >> 8];
+				if (block == 0) block = blockCount++;
+				return block;
+			}
+
+		};
+
+		static const Tables& _tables() {
+			static constexpr Tables tables;
+			// The only whitespace below 0x100 is space and no-break space.
+			static_assert(tables.spacesOnly);
+			return tables;
+		}
+
 	public:
 
-		static uint32_t lowerToUpper(const uint32_t lower) {
-			for (size_t idx = 0 ; idx < _lowerUpperCodePointPairCount ; idx += 2) {
-				if (_lowerUpperCodePointPairs[idx] == lower) return _lowerUpperCodePointPairs[idx + 1];
+		static inline uint32_t lowerToUpper(const uint32_t lower) {
+			return _map(_tables().uppers, lower);
+		}
+
+		static inline uint32_t upperToLower(const uint32_t upper) {
+			return _map(_tables().lowers, upper);
+		}
+
+		static inline bool isWhitespace(const uint32_t codePoint) {
+			if (codePoint > 0xFFFF) return false;
+			const Tables& tables = _tables();
+			return (tables.whitespace[tables.blocks[codePoint >> 8]][(codePoint & 0xFF) >> 6] >> (codePoint & 0x3F)) & 1;
+		}
+
+		// Maps length code points into result, which may be units. Returns the mapped code points
+		// or'ed together (ASCII might be left out) - if any of them did not fit in V, the result
+		// must be mapped again into wider units. That only happens when ÿ is upper cased.
+		template<typename U, typename V>
+		static uint32_t uppercase(const U* units, size_t length, V* result) {
+			return _mapBulk(_tables().uppers, 'a', units, length, result);
+		}
+
+		template<typename U, typename V>
+		static uint32_t lowercase(const U* units, size_t length, V* result) {
+			return _mapBulk(_tables().lowers, 'A', units, length, result);
+		}
+
+		// Returns the number of whitespace code points at the start of units.
+		template<typename U>
+		static size_t whitespaceStart(const U* units, size_t length) {
+			size_t idx = 0;
+#ifdef FART_UNICODE_X86
+			if constexpr (sizeof(U) == 1) {
+				for ( ; idx + 16 <= length ; idx += 16) {
+					uint32_t mask = _whitespaceSSE2((const uint8_t*)units + idx) ^ 0xFFFF;
+					if (mask != 0) return idx + __builtin_ctz(mask);
+				}
 			}
-			return lower;
+#endif
+			while (idx < length && isWhitespace(units[idx])) idx++;
+			return idx;
 		}
 
-		static uint32_t upperToLower(const uint32_t upper) {
-			for (size_t idx = 1 ; idx < _lowerUpperCodePointPairCount ; idx += 2) {
-				if (_lowerUpperCodePointPairs[idx] == upper) return _lowerUpperCodePointPairs[idx - 1];
+		// Returns the number of whitespace code points at the end of units.
+		template<typename U>
+		static size_t whitespaceEnd(const U* units, size_t length) {
+			size_t idx = length;
+#ifdef FART_UNICODE_X86
+			if constexpr (sizeof(U) == 1) {
+				for ( ; idx >= 16 ; idx -= 16) {
+					uint32_t mask = _whitespaceSSE2((const uint8_t*)units + idx - 16) ^ 0xFFFF;
+					if (mask != 0) return length - idx + __builtin_clz(mask) - 16;
+				}
 			}
-			return upper;
+#endif
+			while (idx > 0 && isWhitespace(units[idx - 1])) idx--;
+			return length - idx;
 		}
 
-		static inline bool isWhitespace(const uint32_t codePoint) {
-			for (size_t idx = 0 ; idx < _whitespaceCharactersCount ; idx++) {
-				if (_whitespaceCharacters[idx] == codePoint) return true;
+		// Tells if units and others are the same when lower cased. Code points below 0x100 are
+		// compared 16 at a time, when both are one byte wide.
+		template<typename U, typename V>
+		static bool equalIgnoringCase(const U* units, const V* others, size_t length) {
+			size_t idx = 0;
+#ifdef FART_UNICODE_X86
+			if constexpr (sizeof(U) == 1 && sizeof(V) == 1) {
+				for ( ; idx + 16 <= length ; idx += 16) {
+					__m128i block = _lowerLatin1SSE2((const uint8_t*)units + idx);
+					__m128i other = _lowerLatin1SSE2((const uint8_t*)others + idx);
+					if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, other)) != 0xFFFF) return false;
+				}
 			}
-			return false;
+#endif
+			for ( ; idx < length ; idx++) {
+				if (units[idx] != others[idx] && upperToLower(units[idx]) != upperToLower(others[idx])) return false;
+			}
+			return true;
 		}
 
+	private:
+
+		static inline uint32_t _map(const uint16_t (&mappings)[_blockCapacity][256], uint32_t codePoint) {
+			if (codePoint > 0xFFFF) return codePoint;
+			uint16_t mapped = mappings[_tables().blocks[codePoint >> 8]][codePoint & 0xFF];
+			return mapped != 0 ? mapped : codePoint;
+		}
+
+		// ASCII is mapped 16 bytes at a time, by moving the 26 letters starting at first by 0x20.
+		template<typename U, typename V>
+		static uint32_t _mapBulk(const uint16_t (&mappings)[_blockCapacity][256], char first, const U* units, size_t length, V* result) {
+			uint32_t bits = 0;
+			size_t idx = 0;
+#ifdef FART_UNICODE_X86
+			if constexpr (sizeof(U) <= 2 && sizeof(U) == sizeof(V)) {
+				for ( ; idx + 16 / sizeof(U) <= length ; idx += 16 / sizeof(U)) {
+					if (!_mapASCIISSE2(units + idx, result + idx, first)) {
+						for (size_t offset = 0 ; offset < 16 / sizeof(U) ; offset++) {
+							uint32_t mapped = _map(mappings, units[idx + offset]);
+							result[idx + offset] = mapped;
+							bits |= mapped;
+						}
+					}
+				}
+			}
+#endif
+			for ( ; idx < length ; idx++) {
+				uint32_t mapped = _map(mappings, units[idx]);
+				result[idx] = mapped;
+				bits |= mapped;
+			}
+			return bits;
+		}
+
+#ifdef FART_UNICODE_X86
+
+		// Maps a block if it is all ASCII, and tells if it was.
+		template<typename U>
+		static inline bool _mapASCIISSE2(const U* units, U* result, char first) {
+			__m128i block = _mm_loadu_si128((const __m128i*)units);
+			__m128i letters;
+			if constexpr (sizeof(U) == 1) {
+				if (_mm_movemask_epi8(block) != 0) return false;
+				// Letters are the 26 smallest after biasing first to the smallest signed byte.
+				__m128i biased = _mm_add_epi8(block, _mm_set1_epi8(0x80 - first));
+				letters = _mm_cmplt_epi8(biased, _mm_set1_epi8(-0x80 + 26));
+			} else {
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, _mm_set1_epi16(-0x80)), _mm_setzero_si128())) != 0xFFFF) return false;
+				__m128i offset = _mm_sub_epi16(block, _mm_set1_epi16(first));
+				letters = _mm_and_si128(_mm_cmpgt_epi16(offset, _mm_set1_epi16(-1)), _mm_cmplt_epi16(offset, _mm_set1_epi16(26)));
+			}
+			// 'a' - 'A' is the only bit differing between the cases of a letter.
+			__m128i caseBit = sizeof(U) == 1 ? _mm_set1_epi8(0x20) : _mm_set1_epi16(0x20);
+			_mm_storeu_si128((__m128i*)result, _mm_xor_si128(block, _mm_and_si128(letters, caseBit)));
+			return true;
+		}
+
+		// Lower cases 16 code points below 0x100 - where the upper case letters are A to Z, and À to
+		// Þ except ×, all 0x20 below their lower case.
+		static inline __m128i _lowerLatin1SSE2(const uint8_t* units) {
+			__m128i block = _mm_loadu_si128((const __m128i*)units);
+			__m128i ascii = _mm_cmplt_epi8(_mm_add_epi8(block, _mm_set1_epi8(0x80 - 'A')), _mm_set1_epi8(-0x80 + 26));
+			__m128i latin1 = _mm_andnot_si128(
+				_mm_cmpeq_epi8(block, _mm_set1_epi8((char)0xD7)),
+				_mm_cmplt_epi8(_mm_add_epi8(block, _mm_set1_epi8(0x80 - 0xC0)), _mm_set1_epi8(-0x80 + 31)));
+			return _mm_add_epi8(block, _mm_and_si128(_mm_or_si128(ascii, latin1), _mm_set1_epi8(0x20)));
+		}
+
+		// Returns a mask of the whitespace (space and no-break space) among 16 code points below 0x100.
+		static inline uint32_t _whitespaceSSE2(const uint8_t* units) {
+			__m128i block = _mm_loadu_si128((const __m128i*)units);
+			return _mm_movemask_epi8(_mm_or_si128(
+				_mm_cmpeq_epi8(block, _mm_set1_epi8(0x20)),
+				_mm_cmpeq_epi8(block, _mm_set1_epi8((char)0xA0))));
+		}
+
+#endif
+
 	};
 
 }
@@ -41,23 +41,20 @@ namespace fart::web {
 
 		static String escapeEncode(const String& string) {
 
-			String result;
-
 			Data<uint8_t> utf8Data = string.UTF8Data();
 
+			String::Builder result(utf8Data.length());
+
 			for (size_t idx = 0 ; idx < utf8Data.length() ; idx++) {
 				uint8_t codePoint = utf8Data[idx];
 				if (!(codePoint >= 'a' && codePoint <= 'z') && !(codePoint >= 'A' && codePoint < 'Z') && !(codePoint >= '0' && codePoint <= '9')) {
-					result.append(String::fromHex(Data<uint8_t>({ codePoint }))
-						->mapCString<Strong<String>>([](const char* hex) {
-							return String::format("%%%s", hex);
-						}));
+					result.format("%{:02X}", codePoint);
 				} else {
-					result.append(String(Data<uint8_t>({ codePoint })));
+					result.append((uint32_t)codePoint);
 				}
 			}
 
-			return result;
+			return result.string();
 
 		}
 
@@ -68,7 +65,7 @@ namespace fart::web {
 					return strlen(buffer);
 				}, 4096)
 				.mapCString<String>([](const char* cwd) {
-					return String::format("file://%s", cwd);
+					return String::Builder().format("file://{}", cwd).string();
 				}));
 		}
 
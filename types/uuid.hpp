@@ -64,19 +64,10 @@ namespace fart::types {
 		virtual ~UUID() { }
 
 		String string() {
-
-			String all = this->_encode(this->_upper).appending(this->_encode(this->_lower));
-
-			Array<String> result;
-
-			result.append(all.substring(0, 8));
-			result.append(all.substring(8, 4));
-			result.append(all.substring(12, 4));
-			result.append(all.substring(16, 4));
-			result.append(all.substring(20));
-
-			return String::join(result, "-");
-
+			String::Builder builder(36);
+			this->_encode(this->_upper, builder, 0x50);
+			this->_encode(this->_lower, builder, 0x05);
+			return builder.string();
 		}
 
 		virtual Kind kind() const override {
@@ -111,22 +102,21 @@ namespace fart::types {
 			return "0123456789abcdef";
 		}
 
-		String _encode(uint64_t value) const {
+		// Appends value as hex, with a dash before the bytes set in dashes.
+		void _encode(uint64_t value, String::Builder& builder, uint8_t dashes) const {
 
-			value = Endian::fromSystemVariant(value, Endian::Variant::big);
-
-			String characters = UUID::_base64Characters();
+			static const char characters[] = "0123456789abcdef";
 
-			String result;
+			value = Endian::fromSystemVariant(value, Endian::Variant::big);
 
 			uint8_t* bytes = (uint8_t*)&value;
 
 			for (size_t idx = 0 ; idx < sizeof(uint64_t) ; idx++) {
-				result = result.appending(String::format("%02x", bytes[idx]));
+				if (dashes & (1 << idx)) builder.append('-');
+				char hex[2] = { characters[bytes[idx] >> 4], characters[bytes[idx] & 0xF] };
+				builder.append(hex, 2);
 			}
 
-			return result;
-
 		}
 
 		uint64_t _decode(const String& string) const noexcept(false) {
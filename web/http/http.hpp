@@ -24,7 +24,7 @@ namespace fart::web::http {
 	protected:
 
 		virtual void postProcess(const Message<RequestHead>& request, Socket &socket) const {
-			if (!request.hasHeader("connection") || request.headerValue("connection") != String("keep-alive")) {
+			if (!request.hasHeader("connection") || !request.headerValue("connection").equalsIgnoringCase("keep-alive")) {
 				socket.close();
 			}
 		}
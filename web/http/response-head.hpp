@@ -51,7 +51,7 @@ namespace fart::web::http {
 
 			result.append(Head::versionData(_version));
 			result.append(' ');
-			result.append(String::format("%d", _status).UTF8Data());
+			result.append(String::Builder().format("{}", _status).UTF8Data());
 			result.append(' ');
 
 			switch (_status) {
@@ -14,6 +14,7 @@
 #include "../types/string.hpp"
 #include "../types/data.hpp"
 #include "../types/dictionary.hpp"
+#include "../types/atoms.hpp"
 #include "../exceptions/exception.hpp"
 
 using namespace fart::types;
@@ -52,7 +53,8 @@ namespace fart::web {
 
 		Message() : _lineBreakMode(LineBreakMode::crLf) {};
 
-		Message(Data<uint8_t>& data) noexcept(false) : Head(data) {
+		// If internKeys is set, header keys are atoms (see Atoms).
+		Message(Data<uint8_t>& data, bool internKeys = false) noexcept(false) : Head(data) {
 
 			_lineBreakMode = determineLineBreakMode(data);
 
@@ -69,14 +71,15 @@ namespace fart::web {
 
 			Array<Data<uint8_t>> header = parts[0]->split(lineBreak);
 
-			header.forEach([this](const Data<uint8_t>& current) {
-				Data<uint8_t> keyValueSplitter((uint8_t *)": ", 2);
+			static const Data<uint8_t>::Separators keyValueSplitter(Data<uint8_t>((uint8_t *)": ", 2));
+
+			header.forEach([this,internKeys](const Data<uint8_t>& current) {
 				Array<Data<uint8_t>> parts = current.split(keyValueSplitter);
 				if (parts.count() != 2) throw DataIncompleteException();
 				Array<String> strings = parts.map<String>([](const Data<uint8_t>& current) {
 					return String(current);
 				});
-				_headers.set(strings[0], strings[1]);
+				_headers.set(internKeys ? Atoms::intern(strings[0]) : strings[0], strings[1]);
 			});
 
 			if (_headers.hasKey("content-length")) {
@@ -132,30 +135,25 @@ namespace fart::web {
 		}
 
 		void setBody(Data<uint8_t>& data) {
-			setHeaderValue("Content-Length", String::format("%d", data.length()));
+			setHeaderValue("Content-Length", String::Builder().format("{}", data.length()).string());
 			_body = data;
 		}
 
 		Data<uint8_t> data() const {
 
-			Data<uint8_t> result;
+			String::Builder builder;
 			Data<uint8_t> lineBreak = dataForLineBreakMode(lineBreakMode());
 
-			result.append(Head::headData(lineBreak));
+			builder.append(Head::headData(lineBreak));
 
-			_headers.forEach([&result,&lineBreak](const Pair<String, String>& entry) {
-				entry.first().withCString([&result,&entry](const char* key){
-					entry.second().withCString([&result,key](const char* value){
-						result.append(String::format("%s: %s", key, value).UTF8Data());
-					});
-				});
-				result.append(lineBreak);
+			_headers.forEach([&builder,&lineBreak](const Pair<String, String>& entry) {
+				builder.format("{}: {}", entry.first(), entry.second()).append(lineBreak);
 			});
 
-			result.append(lineBreak);
-			result.append(_body);
+			builder.append(lineBreak);
+			builder.append(_body);
 
-			return result;
+			return builder.UTF8Data();
 
 		}
 
@@ -194,7 +192,7 @@ namespace fart::web {
 	private:
 
 		LineBreakMode _lineBreakMode;
-		Dictionary<String, String> _headers;
+		Dictionary<String, String, String::CaseInsensitive> _headers;
 		Data<uint8_t> _body;
 
 	};
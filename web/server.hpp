@@ -10,10 +10,12 @@
 #define server_hpp
 
 #include <thread>
+#include <exception>
 
 #include "./message.hpp"
 #include "../io/sockets/socket.hpp"
 #include "../memory/object.hpp"
+#include "../memory/arena.hpp"
 
 using namespace fart::io::sockets;
 
@@ -26,13 +28,15 @@ namespace fart::web {
 
 	public:
 
-		Server(uint16_t port, function<void(const Message<Request>& request, Message<Response>& response)> requestHandler) : _requestHandler(requestHandler) {
+		// With useArena, each request (parsing, handling and response) is allocated in an arena
+		// of its connection, which is reset when the response has been sent.
+		Server(uint16_t port, function<void(const Message<Request>& request, Message<Response>& response)> requestHandler, bool useArena = false) : _requestHandler(requestHandler), _useArena(useArena) {
 			_listener->bind(port);
 			_listener->listen([this](Socket& acceptSocket) {
 				acceptSocket.setCloseCallback(_socketClosed, this);
 				_connections.append(acceptSocket);
-				acceptSocket.accept([this,&acceptSocket](const Data<uint8_t>& data, const Endpoint&) {
-					this->_onData(data, acceptSocket);
+				acceptSocket.accept([this,&acceptSocket,connection = Strong<Connection>()](const Data<uint8_t>& data, const Endpoint&) {
+					this->_onData(data, acceptSocket, connection);
 				});
 			});
 		}
@@ -43,6 +47,16 @@ namespace fart::web {
 
 	private:
 
+		// Connections are read on threads of their own, so each has its own buffer and arena.
+		class Connection : public Object {
+
+		public:
+
+			Data<uint8_t> backbuffer;
+			Arena arena;
+
+		};
+
 		void _socketClosed(const Socket& socket) {
 			_connections.removeItem(socket);
 		}
@@ -51,14 +65,43 @@ namespace fart::web {
 			((Server<Request, Response>*)context)->_socketClosed(socket);
 		}
 
-		void _onData(const Data<uint8_t>& data, Socket& socket) {
+		void _onData(const Data<uint8_t>& data, Socket& socket, Connection& connection) {
+
+			connection.backbuffer.append(data);
+
+			if (!_useArena) return _handle(connection.backbuffer, socket);
+
+			size_t consumed;
+			exception_ptr exception = nullptr;
+
+			{
+				Arena::Scope scope(connection.arena);
+				// The backbuffer outlives the request, so it must not be reallocated in the
+				// arena. The request is parsed from a copy, which shares its storage.
+				Data<uint8_t> buffer(connection.backbuffer);
+				// What was parsed is consumed, and the arena reset, even if handling throws.
+				try {
+					_handle(buffer, socket);
+				} catch (...) {
+					exception = current_exception();
+				}
+				consumed = connection.backbuffer.length() - buffer.length();
+			}
+
+			connection.backbuffer.remove(0, consumed);
+
+			connection.arena.reset();
+
+			if (exception != nullptr) rethrow_exception(exception);
+
+		}
 
-			_backbuffer->append(data);
+		void _handle(Data<uint8_t>& buffer, Socket& socket) {
 
 			Strong<Message<Request>> request = nullptr;
 
 			try {
-				request = Strong<Message<Request>>(_backbuffer);
+				request = Strong<Message<Request>>(buffer);
 			} catch (const DataIncompleteException&) {
 				return;
 			} catch (const DataMalformedException&) {
@@ -77,8 +120,8 @@ namespace fart::web {
 
 		Strong<Socket> _listener;
 		Array<Socket> _connections;
-		Strong<Data<uint8_t>> _backbuffer;
 		function<void(const Message<Request>& request, Message<Response>& response)> _requestHandler;
+		bool _useArena;
 
 	};
 